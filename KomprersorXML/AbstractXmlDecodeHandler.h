@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+
+/// <summary>
+/// Wartosc znacznika lub atrybutu odczytana ze skompresowanego pliku w swoim pierwotnym typie
+/// </summary>
+struct XmlValue
+{
+	enum Type { String, Char, Short, Int, Float };
+
+	Type type;
+
+	union
+	{
+		/// wartosc typow Char, Short i Int
+		int intValue;
+		/// wartosc typu Float
+		float floatValue;
+	};
+
+	/// <summary>
+	/// Tekst wartosci typu String; wskazuje na zrodlo wartosci i nie jest zakonczony zerem
+	/// </summary>
+	char const * text;
+	size_t length;
+};
+
+/// <summary>
+/// Abstrakcyjna podstawa dla odbiorcow zdarzen dekompresji. Zdarzenia generowane sa bezposrednio
+/// ze strumieni struktury i wartosci, bez tworzenia tekstu Xml.
+/// </summary>
+class AbstractXmlDecodeHandler
+{
+public:
+	virtual ~AbstractXmlDecodeHandler() { }
+
+	/// <summary>
+	/// Poczatek wezla; po nim nastepuja jego atrybuty.
+	/// </summary>
+	/// <param name="id">Identyfikator nazwy znacznika.</param>
+	/// <param name="name">Nazwa znacznika.</param>
+	virtual void startElement(int id, std::string const & name) = 0;
+
+	/// <summary>
+	/// Atrybut ostatnio rozpoczetego wezla.
+	/// </summary>
+	/// <param name="id">Identyfikator nazwy atrybutu.</param>
+	/// <param name="name">Nazwa atrybutu.</param>
+	/// <param name="value">Wartosc atrybutu.</param>
+	virtual void attribute(int id, std::string const & name, XmlValue const & value) = 0;
+
+	/// <summary>
+	/// Wartosc tekstowa ostatnio rozpoczetego wezla.
+	/// </summary>
+	/// <param name="value">Wartosc wezla.</param>
+	virtual void text(XmlValue const & value) = 0;
+
+	/// <summary>
+	/// Koniec wezla.
+	/// </summary>
+	/// <param name="id">Identyfikator nazwy znacznika.</param>
+	/// <param name="name">Nazwa znacznika.</param>
+	virtual void endElement(int id, std::string const & name) = 0;
+};
@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "CompresorXml.h"
+#include "WorkStealingPool.h"
+
+/// <summary>
+/// Kompresuje lub dekompresuje wiele plikow w jednym procesie albo zbiera z nich statystyki
+/// do uczenia zestawu czestosci lub probki do uczenia slownika. Pliki przetwarzane sa przez pule watkow z kradzieza zadan,
+/// od najwiekszych; kazdy watek uzywa jednego obiektu CompresorXml dla wszystkich swoich plikow.
+/// </summary>
+class BatchCompressor
+{
+public:
+	enum Mode
+	{
+		Compress, Decompress, Train, TrainDictionary
+	};
+
+private:
+	typedef std::experimental::filesystem::path Path;
+
+	/// <summary>
+	/// Rozszerzenie skompresowanych plikow
+	/// </summary>
+	static constexpr char const * BINARY_EXTENSION = ".bin";
+
+	/// <summary>
+	/// Plik do przetworzenia
+	/// </summary>
+	struct Job
+	{
+		std::string source;
+		std::string target;
+		uintmax_t size;
+	};
+
+	Mode _mode;
+
+	/// <summary>
+	/// Katalog wyjsciowy; pusty, jezeli pliki wynikowe zapisywane sa obok zrodlowych
+	/// </summary>
+	Path _outputDirectory;
+
+	std::vector<Job> _jobs;
+
+	std::shared_ptr<PriorSet const> _priorSet;
+
+	/// <summary>
+	/// Liczniki symboli sekcji zebrane w trybie uczenia
+	/// </summary>
+	std::vector<LzssCoder::Frequencies> _statistics;
+
+	std::shared_ptr<LzDictionary const> _dictionary;
+
+	LzssCoder::Backend _backend;
+
+	bool _parameterSearch;
+
+	/// <summary>
+	/// Dane wejsciowe sekcji zebrane w trybie uczenia slownika
+	/// </summary>
+	std::vector<std::vector<std::string>> _samples;
+
+public:
+	/// <summary>
+	/// Inicjalizuje obiekt klasy <see cref="BatchCompressor"/>.
+	/// </summary>
+	/// <param name="mode">Kompresja albo dekompresja.</param>
+	/// <param name="outputDirectory">Katalog wyjsciowy; pusty, aby zapisywac wyniki obok plikow zrodlowych.</param>
+	BatchCompressor(Mode mode, std::string const & outputDirectory = "")
+		: _mode(mode), _outputDirectory(outputDirectory), _backend(LzssCoder::RANGE_CODER), _parameterSearch(false)
+	{
+	}
+
+	/// <summary>
+	/// Ustawia zestaw poczatkowych czestosci modeli uzywany przy kompresji i dekompresji.
+	/// </summary>
+	void setPriorSet(std::shared_ptr<PriorSet const> priorSet)
+	{
+		_priorSet = priorSet;
+	}
+
+	/// <summary>
+	/// Ustawia slowniki sekcji LZSS uzywane przy kompresji i dekompresji.
+	/// </summary>
+	void setDictionary(std::shared_ptr<LzDictionary const> dictionary)
+	{
+		_dictionary = dictionary;
+	}
+
+	/// <summary>
+	/// Wybiera koder entropijny sekcji LZSS kompresowanych plikow.
+	/// </summary>
+	void setBackend(LzssCoder::Backend backend)
+	{
+		_backend = backend;
+	}
+
+	/// <summary>
+	/// Wlacza wybor parametrow modeli qsmodel kazdej sekcji LZSS kompresowanych plikow.
+	/// </summary>
+	void setParameterSearch(bool enabled)
+	{
+		_parameterSearch = enabled;
+	}
+
+	/// <summary>
+	/// Liczniki symboli kolejnych sekcji zebrane przez run w trybie uczenia.
+	/// </summary>
+	std::vector<LzssCoder::Frequencies> const & statistics() const
+	{
+		return _statistics;
+	}
+
+	/// <summary>
+	/// Probki kolejnych sekcji zebrane przez run w trybie uczenia slownika.
+	/// </summary>
+	std::vector<std::vector<std::string>> const & samples() const
+	{
+		return _samples;
+	}
+
+	/// <summary>
+	/// Dodaje pliki do przetworzenia: katalog (rekurencyjnie, pliki .bin przy dekompresji i .xml
+	/// w pozostalych trybach), liste plikow podana jako @sciezka (jedna sciezka w wierszu) albo pojedynczy plik.
+	/// </summary>
+	/// <param name="argument">Katalog, lista plikow lub plik.</param>
+	void add(std::string const & argument)
+	{
+		namespace fs = std::experimental::filesystem;
+		if (!argument.empty() && argument[0] == '@')
+		{
+			std::ifstream list(argument.substr(1));
+			if (!list)
+				throw std::runtime_error("Nie mozna otworzyc listy plikow " + argument.substr(1));
+			std::string line;
+			while (std::getline(list, line))
+			{
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty())
+					addFile(line, Path(line).filename());
+			}
+		}
+		else if (fs::is_directory(argument))
+		{
+			std::string root = argument;
+			while (root.size() > 1 && (root.back() == '/' || root.back() == '\\'))
+				root.pop_back();
+			for (fs::recursive_directory_iterator it(argument), end; it != end; ++it)
+			{
+				if (!fs::is_regular_file(it->status()) || !hasInputExtension(it->path()))
+					continue;
+				std::string file = it->path().string();
+				Path relative = file.substr(std::min(file.size(), root.size() + 1));
+				addFile(file, relative);
+			}
+		}
+		else
+		{
+			addFile(argument, Path(argument).filename());
+		}
+	}
+
+	/// <summary>
+	/// Przetwarza wszystkie dodane pliki. Plik, ktorego sciezka wynikowa powtarza sciezke wczesniej
+	/// dodanego pliku, nie jest przetwarzany i liczony jest jako nieudany.
+	/// </summary>
+	/// <param name="threadCount">Liczba watkow; 0 oznacza liczbe rdzeni.</param>
+	/// <returns>Liczba plikow, ktorych nie udalo sie przetworzyc</returns>
+	size_t run(size_t threadCount = 0)
+	{
+		std::atomic<size_t> failed(removeDuplicateTargets());
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::max<size_t>(1, std::min(threadCount, _jobs.size()));
+
+		// najwieksze pliki najpierw, aby na koncu nie czekac na pojedynczy dlugi plik
+		std::stable_sort(_jobs.begin(), _jobs.end(), [](Job const & a, Job const & b)
+		{
+			return a.size > b.size;
+		});
+
+		std::vector<std::unique_ptr<CompresorXml>> compressors;
+		for (size_t i = 0; i < threadCount; ++i)
+		{
+			compressors.emplace_back(new CompresorXml());
+			compressors.back()->setPriorSet(_priorSet);
+			compressors.back()->setDictionary(_dictionary);
+			compressors.back()->setBackend(_backend);
+			compressors.back()->setParameterSearch(_parameterSearch);
+		}
+		std::vector<std::vector<LzssCoder::Frequencies>> statistics(threadCount);
+		std::vector<std::vector<std::vector<std::string>>> samples(threadCount);
+
+		WorkStealingPool<Job> pool;
+		pool.run(_jobs, threadCount, [&](size_t worker, Job const & job)
+		{
+			bool processed = _mode == Train ? compressors[worker]->collectStatistics(job.source, statistics[worker])
+				: _mode == TrainDictionary ? compressors[worker]->collectSamples(job.source, samples[worker])
+				: process(*compressors[worker], job);
+			if (!processed)
+				++failed;
+		});
+		_jobs.clear();
+
+		_statistics.clear();
+		for (auto const & workerStatistics : statistics)
+		{
+			_statistics.resize(std::max(_statistics.size(), workerStatistics.size()));
+			for (size_t i = 0; i < workerStatistics.size(); ++i)
+				_statistics[i].add(workerStatistics[i]);
+		}
+		_samples.clear();
+		for (auto & workerSamples : samples)
+		{
+			_samples.resize(std::max(_samples.size(), workerSamples.size()));
+			for (size_t i = 0; i < workerSamples.size(); ++i)
+				_samples[i].insert(_samples[i].end(), workerSamples[i].begin(), workerSamples[i].end());
+		}
+		return failed;
+	}
+
+private:
+	/// <summary>
+	/// Usuwa pliki, ktore zapisalyby wynik do tej samej sciezki co wczesniej dodany plik,
+	/// np. pliki o tej samej nazwie z roznych katalogow przy katalogu wyjsciowym.
+	/// </summary>
+	/// <returns>Liczba usunietych plikow</returns>
+	size_t removeDuplicateTargets()
+	{
+		if (_mode == Train || _mode == TrainDictionary)
+			return 0;
+		std::unordered_set<std::string> targets;
+		std::vector<Job> unique;
+		for (auto & job : _jobs)
+		{
+			if (targets.insert(job.target).second)
+				unique.push_back(std::move(job));
+			else
+				std::cerr << job.source << ": plik wynikowy " << job.target << " powtarza sie" << std::endl;
+		}
+		size_t removed = _jobs.size() - unique.size();
+		_jobs.swap(unique);
+		return removed;
+	}
+
+	/// <summary>
+	/// Kompresuje lub dekompresuje jeden plik.
+	/// </summary>
+	/// <returns><c>true</c> jezeli plik zostal przetworzony</returns>
+	bool process(CompresorXml & compressor, Job const & job)
+	{
+		if (_mode == Compress)
+			return compressor.encode(job.source, job.target);
+		try
+		{
+			compressor.decode(job.source, job.target);
+			return true;
+		}
+		catch (std::exception const & ex)
+		{
+			std::cerr << job.source << ": " << ex.what() << std::endl;
+			return false;
+		}
+	}
+
+	/// <summary>
+	/// Dodaje plik wraz ze sciezka wynikowa.
+	/// </summary>
+	/// <param name="source">Plik zrodlowy.</param>
+	/// <param name="relative">Sciezka pliku wzgledem katalogu wyjsciowego.</param>
+	void addFile(std::string const & source, Path relative)
+	{
+		namespace fs = std::experimental::filesystem;
+		std::error_code error;
+		uintmax_t size = fs::file_size(source, error);
+		if (error)
+			size = 0;
+
+		if (_mode == Train || _mode == TrainDictionary)
+		{
+			_jobs.push_back({ source, std::string(), size });
+			return;
+		}
+		Path target = _outputDirectory.empty() ? Path(source) : _outputDirectory / relative;
+		if (_mode == Compress)
+			target += BINARY_EXTENSION;
+		else if (hasExtension(target, BINARY_EXTENSION))
+			target.replace_extension();
+		else
+			target += ".xml";
+		if (!_outputDirectory.empty())
+			fs::create_directories(target.parent_path(), error);
+		_jobs.push_back({ source, target.string(), size });
+	}
+
+	bool hasInputExtension(Path const & path)
+	{
+		return hasExtension(path, _mode == Decompress ? BINARY_EXTENSION : ".xml");
+	}
+
+	static bool hasExtension(Path const & path, std::string const & extension)
+	{
+		std::string actual = path.extension().string();
+		return actual.size() == extension.size() && std::equal(actual.begin(), actual.end(), extension.begin(),
+			[](char a, char b) { return std::tolower((unsigned char)a) == b; });
+	}
+};
@@ -0,0 +1,300 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/// <summary>
+/// Binarny koder zakresowy w stylu LZMA: kazdy bit kodowany jest z prawdopodobienstwem zera zapisanym
+/// na 11 bitach i aktualizowanym przesunieciem, bez dzielenia i bez przeszukiwania tablic czestosci.
+/// Dekoder odczytuje dokladnie tyle bajtow, ile zapisal koder, dlatego sekcja nie potrzebuje zapisanej dlugosci.
+/// </summary>
+class BinaryRangeCoder
+{
+public:
+	typedef uint16_t Probability;
+
+	static const int PROBABILITY_BITS = 11;
+	static const Probability INITIAL_PROBABILITY = 1 << (PROBABILITY_BITS - 1);
+
+	/// <summary>
+	/// Dokladnosc prawdopodobienstw przekazywanych z zewnatrz do encodePredicted i decodePredicted
+	/// </summary>
+	static const int PREDICTION_BITS = 12;
+
+private:
+	static const int MOVE_BITS = 5;
+	static const uint32_t TOP = 1u << 24;
+
+	/// <summary>
+	/// Liczba bajtow konczacych zapis kodera; dekoder nie powinien odczytac wiecej bajtow za koncem pliku
+	/// </summary>
+	static const int FLUSH_SIZE = 5;
+
+	// stan kodera
+	std::vector<char> * _sink;
+	uint64_t _low;
+	unsigned char _cache;
+	uint64_t _cacheSize;
+
+	// stan dekodera
+	unsigned char const * _input;
+	unsigned char const * _inputEnd;
+	int _bytesPastEnd;
+	uint32_t _code;
+
+	uint32_t _range;
+
+public:
+	BinaryRangeCoder() : _sink(nullptr), _low(0), _cache(0), _cacheSize(0), _input(nullptr), _inputEnd(nullptr), _bytesPastEnd(0), _code(0), _range(0)
+	{
+	}
+
+	/// <summary>
+	/// Rozpoczyna kompresje; bajty dopisywane sa na koniec wektora.
+	/// </summary>
+	void startEncoding(std::vector<char> & sink)
+	{
+		_sink = &sink;
+		_low = 0;
+		_range = 0xFFFFFFFF;
+		_cache = 0;
+		_cacheSize = 1;
+	}
+
+	/// <summary>
+	/// Zapisuje bajty pozostale w koderze.
+	/// </summary>
+	void doneEncoding()
+	{
+		for (int i = 0; i < FLUSH_SIZE; ++i)
+			shiftLow();
+	}
+
+	/// <summary>
+	/// Rozpoczyna dekompresje zawartosci pliku od podanej pozycji.
+	/// </summary>
+	void startDecoding(std::vector<char> const & source, int pos)
+	{
+		_input = reinterpret_cast<unsigned char const *>(source.data()) + pos;
+		_inputEnd = reinterpret_cast<unsigned char const *>(source.data()) + source.size();
+		_bytesPastEnd = 0;
+		_range = 0xFFFFFFFF;
+		_code = 0;
+		for (int i = 0; i < FLUSH_SIZE; ++i)
+			_code = _code << 8 | nextByte();
+	}
+
+	/// <summary>
+	/// Zwraca pozycje w pliku za ostatnim bajtem odczytanym przez dekoder.
+	/// </summary>
+	int position(std::vector<char> const & source) const
+	{
+		return static_cast<int>(_input - reinterpret_cast<unsigned char const *>(source.data()));
+	}
+
+	void encodeBit(Probability & probability, int bit)
+	{
+		uint32_t bound = (_range >> PROBABILITY_BITS) * probability;
+		if (bit == 0)
+		{
+			_range = bound;
+			probability += ((1 << PROBABILITY_BITS) - probability) >> MOVE_BITS;
+		}
+		else
+		{
+			_low += bound;
+			_range -= bound;
+			probability -= probability >> MOVE_BITS;
+		}
+		while (_range < TOP)
+		{
+			_range <<= 8;
+			shiftLow();
+		}
+	}
+
+	int decodeBit(Probability & probability)
+	{
+		uint32_t bound = (_range >> PROBABILITY_BITS) * probability;
+		int bit;
+		if (_code < bound)
+		{
+			_range = bound;
+			probability += ((1 << PROBABILITY_BITS) - probability) >> MOVE_BITS;
+			bit = 0;
+		}
+		else
+		{
+			_code -= bound;
+			_range -= bound;
+			probability -= probability >> MOVE_BITS;
+			bit = 1;
+		}
+		normalizeDecoder();
+		return bit;
+	}
+
+	/// <summary>
+	/// Koduje bit z prawdopodobienstwem jedynki na PREDICTION_BITS bitach, wyznaczonym przez zewnetrzny model.
+	/// </summary>
+	void encodePredicted(int probability, int bit)
+	{
+		uint32_t bound = (_range >> PREDICTION_BITS) * static_cast<uint32_t>((1 << PREDICTION_BITS) - probability);
+		if (bit == 0)
+			_range = bound;
+		else
+		{
+			_low += bound;
+			_range -= bound;
+		}
+		while (_range < TOP)
+		{
+			_range <<= 8;
+			shiftLow();
+		}
+	}
+
+	int decodePredicted(int probability)
+	{
+		uint32_t bound = (_range >> PREDICTION_BITS) * static_cast<uint32_t>((1 << PREDICTION_BITS) - probability);
+		int bit;
+		if (_code < bound)
+		{
+			_range = bound;
+			bit = 0;
+		}
+		else
+		{
+			_code -= bound;
+			_range -= bound;
+			bit = 1;
+		}
+		normalizeDecoder();
+		return bit;
+	}
+
+	/// <summary>
+	/// Zapisuje bity bez modelu, od najstarszego.
+	/// </summary>
+	void encodeDirectBits(uint32_t value, int count)
+	{
+		while (count-- > 0)
+		{
+			_range >>= 1;
+			if (value >> count & 1)
+				_low += _range;
+			while (_range < TOP)
+			{
+				_range <<= 8;
+				shiftLow();
+			}
+		}
+	}
+
+	uint32_t decodeDirectBits(int count)
+	{
+		uint32_t value = 0;
+		while (count-- > 0)
+		{
+			_range >>= 1;
+			uint32_t bit = _code >= _range ? 1 : 0;
+			if (bit)
+				_code -= _range;
+			value = value << 1 | bit;
+			normalizeDecoder();
+		}
+		return value;
+	}
+
+	/// <summary>
+	/// Koduje liczbe drzewem bitow od najstarszego; probabilities ma 1 &lt;&lt; count elementow.
+	/// </summary>
+	void encodeTree(Probability * probabilities, int count, uint32_t value)
+	{
+		uint32_t node = 1;
+		while (count-- > 0)
+		{
+			int bit = value >> count & 1;
+			encodeBit(probabilities[node], bit);
+			node = node << 1 | bit;
+		}
+	}
+
+	uint32_t decodeTree(Probability * probabilities, int count)
+	{
+		uint32_t node = 1;
+		for (int i = 0; i < count; ++i)
+			node = node << 1 | decodeBit(probabilities[node]);
+		return node - (1u << count);
+	}
+
+	/// <summary>
+	/// Koduje liczbe drzewem bitow od najmlodszego, jak bity dolne odleglosci w LZMA.
+	/// </summary>
+	void encodeReverseTree(Probability * probabilities, int count, uint32_t value)
+	{
+		uint32_t node = 1;
+		for (int i = 0; i < count; ++i)
+		{
+			int bit = value & 1;
+			value >>= 1;
+			encodeBit(probabilities[node], bit);
+			node = node << 1 | bit;
+		}
+	}
+
+	uint32_t decodeReverseTree(Probability * probabilities, int count)
+	{
+		uint32_t node = 1, value = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			int bit = decodeBit(probabilities[node]);
+			node = node << 1 | bit;
+			value |= uint32_t(bit) << i;
+		}
+		return value;
+	}
+
+private:
+	/// <summary>
+	/// Wysyla najstarszy bajt low; bajty 0xFF wstrzymywane sa do czasu poznania przeniesienia.
+	/// </summary>
+	void shiftLow()
+	{
+		if (static_cast<uint32_t>(_low) < 0xFF000000u || (_low >> 32) != 0)
+		{
+			unsigned char carry = static_cast<unsigned char>(_low >> 32);
+			unsigned char pending = _cache;
+			do
+			{
+				_sink->push_back(static_cast<char>(pending + carry));
+				pending = 0xFF;
+			} while (--_cacheSize != 0);
+			_cache = static_cast<unsigned char>(_low >> 24);
+		}
+		++_cacheSize;
+		_low = (_low & 0x00FFFFFF) << 8;
+	}
+
+	void normalizeDecoder()
+	{
+		while (_range < TOP)
+		{
+			_range <<= 8;
+			_code = _code << 8 | nextByte();
+		}
+	}
+
+	/// <summary>
+	/// Kolejny bajt wejscia; za koncem pliku zera, aby uszkodzony plik nie powodowal odczytu poza nim.
+	/// Uciety plik, z ktorego dekoder czyta dalej niz bajty konczace zapis, jest odrzucany.
+	/// </summary>
+	unsigned char nextByte()
+	{
+		if (_input < _inputEnd)
+			return *_input++;
+		if (++_bytesPastEnd > FLUSH_SIZE)
+			throw std::runtime_error("Niepoprawna sekcja range codera");
+		return 0;
+	}
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "text_encoding_detect.h"
+#include "Utf16Transcoder.h"
+
+using namespace AutoIt::Common;
+
+/// <summary>
+/// Bufor wyjsciowy dekompresowanego pliku Xml. Tekst UTF-8 dopisywany jest do bufora o stalym
+/// rozmiarze, ktory po zapelnieniu zostaje zapisany do pliku w kodowaniu pliku pierwotnego,
+/// dzieki czemu pamiec dekompresji nie zalezy od rozmiaru wyniku. Zamiast pliku wynik moze byc
+/// dopisywany do lancucha w pamieci.
+/// </summary>
+class BufferedXmlWriter
+{
+	static const size_t BUFFER_SIZE = 64 << 10;
+
+	std::ofstream _file;
+
+	/// <summary>
+	/// Lancuch docelowy albo nullptr, jezeli wynik zapisywany jest do pliku
+	/// </summary>
+	std::string * _memory;
+
+	bool _open;
+	std::vector<char> _buffer;
+	size_t _size;
+	bool _utf16, _bigEndian;
+
+	/// <summary>
+	/// Bufor pomocniczy na fragment przekodowany do UTF-16
+	/// </summary>
+	std::string _utf16Chunk;
+
+public:
+	/// <summary>
+	/// Otwiera plik docelowy i zapisuje BOM, jezeli posiadal go plik pierwotny.
+	/// </summary>
+	/// <param name="target">Sciezka do pliku docelowego.</param>
+	/// <param name="encoding">Kodowanie pliku pierwotnego.</param>
+	BufferedXmlWriter(std::string const & target, TextEncodingDetect::Encoding encoding)
+		: _memory(nullptr), _open(true), _buffer(BUFFER_SIZE), _size(0)
+	{
+		setEncoding(encoding);
+		_file.open(target, _utf16 ? std::ios::out | std::ios::binary : std::ios::out);
+		writeBom(encoding);
+	}
+
+	/// <summary>
+	/// Ustawia lancuch, na koniec ktorego dopisywany jest wynik, i dopisuje BOM, jezeli posiadal go plik pierwotny.
+	/// Znaki konca wiersza nie sa zamieniane.
+	/// </summary>
+	/// <param name="target">Lancuch docelowy.</param>
+	/// <param name="encoding">Kodowanie pliku pierwotnego.</param>
+	BufferedXmlWriter(std::string & target, TextEncodingDetect::Encoding encoding)
+		: _memory(&target), _open(true), _buffer(BUFFER_SIZE), _size(0)
+	{
+		setEncoding(encoding);
+		writeBom(encoding);
+	}
+
+	~BufferedXmlWriter()
+	{
+		close();
+	}
+
+	void append(char c)
+	{
+		if (_size == BUFFER_SIZE)
+			flush(false);
+		_buffer[_size++] = c;
+	}
+
+	void append(char const * text, size_t length)
+	{
+		while (length > 0)
+		{
+			if (_size == BUFFER_SIZE)
+				flush(false);
+			size_t count = std::min(length, BUFFER_SIZE - _size);
+			memcpy(_buffer.data() + _size, text, count);
+			_size += count;
+			text += count;
+			length -= count;
+		}
+	}
+
+	void append(std::string const & text)
+	{
+		append(text.data(), text.size());
+	}
+
+	template <size_t N>
+	void append(char const (&text)[N])
+	{
+		append(text, N - 1);
+	}
+
+	/// <summary>
+	/// Zwraca miejsce w buforze na co najwyzej count znakow, zapisywanych bezposrednio przez wywolujacego.
+	/// Liczbe faktycznie zapisanych znakow nalezy potwierdzic wywolaniem commit.
+	/// </summary>
+	char * reserve(size_t count)
+	{
+		if (BUFFER_SIZE - _size < count)
+			flush(false);
+		return _buffer.data() + _size;
+	}
+
+	void commit(size_t count)
+	{
+		_size += count;
+	}
+
+	/// <summary>
+	/// Dopisuje znak powtorzony podana liczbe razy, np. wciecie z tabulatorow.
+	/// </summary>
+	void appendRepeated(char c, size_t count)
+	{
+		while (count > 0)
+		{
+			if (_size == BUFFER_SIZE)
+				flush(false);
+			size_t n = std::min(count, BUFFER_SIZE - _size);
+			memset(_buffer.data() + _size, c, n);
+			_size += n;
+			count -= n;
+		}
+	}
+
+	/// <summary>
+	/// Zapisuje pozostala zawartosc bufora i zamyka plik.
+	/// </summary>
+	void close()
+	{
+		if (!_open)
+			return;
+		flush(true);
+		_open = false;
+		if (!_memory)
+			_file.close();
+	}
+
+private:
+	void setEncoding(TextEncodingDetect::Encoding encoding)
+	{
+		_bigEndian = encoding == TextEncodingDetect::UTF16_BE_BOM || encoding == TextEncodingDetect::UTF16_BE_NOBOM;
+		_utf16 = _bigEndian || encoding == TextEncodingDetect::UTF16_LE_BOM || encoding == TextEncodingDetect::UTF16_LE_NOBOM;
+	}
+
+	void writeBom(TextEncodingDetect::Encoding encoding)
+	{
+		if (encoding == TextEncodingDetect::UTF8_BOM)
+			write("\xEF\xBB\xBF", 3);
+		else if (encoding == TextEncodingDetect::UTF16_LE_BOM)
+			write("\xFF\xFE", 2);
+		else if (encoding == TextEncodingDetect::UTF16_BE_BOM)
+			write("\xFE\xFF", 2);
+	}
+
+	void write(char const * data, size_t length)
+	{
+		if (_memory)
+			_memory->append(data, length);
+		else
+			_file.write(data, length);
+	}
+
+	/// <summary>
+	/// Zapisuje zawartosc bufora do pliku. Przy wyjsciu UTF-16 niepelna sekwencja UTF-8
+	/// z konca bufora zostaje w nim do kolejnego zapisu, o ile nie jest to zapis ostatni.
+	/// </summary>
+	void flush(bool last)
+	{
+		size_t ready = _size;
+		if (!_utf16)
+		{
+			write(_buffer.data(), ready);
+		}
+		else
+		{
+			if (!last)
+				ready = completeUtf8Length();
+			_utf16Chunk.clear();
+			Utf16Transcoder::fromUtf8(_buffer.data(), ready, _bigEndian, _utf16Chunk);
+			write(_utf16Chunk.data(), _utf16Chunk.size());
+		}
+		memmove(_buffer.data(), _buffer.data() + ready, _size - ready);
+		_size -= ready;
+	}
+
+	/// <summary>
+	/// Dlugosc poczatku bufora konczacego sie na pelnym znaku UTF-8.
+	/// </summary>
+	size_t completeUtf8Length()
+	{
+		size_t lead = _size;
+		while (lead > 0 && _size - lead < 4 && (_buffer[lead - 1] & 0xC0) == 0x80)
+			--lead;
+		if (lead == 0)
+			return _size;
+		unsigned char c = _buffer[lead - 1];
+		size_t sequence = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+		return _size - lead + 1 < sequence ? lead - 1 : _size;
+	}
+};
@@ -6,12 +6,22 @@
 #include <iostream>
 #include <algorithm>
 #include <stack>
+#include <memory>
+#include <thread>
 #include "rapidxml\rapidxml.hpp"
 #include "rapidxml\rapidxml_print.hpp"
 #include "LzssCoder.h"
+#include "LzDictionary.h"
+#include "PriorSet.h"
 #include "text_encoding_detect.h"
-#include "ReadByteStrategyFactory.h"
-#include "AbstractReadByteStrategy.h"
+#include "FixedWidthBytes.h"
+#include "StructureTokenCoder.h"
+#include "XmlRecordSplitter.h"
+#include "Utf16Transcoder.h"
+#include "BufferedXmlWriter.h"
+#include "AbstractXmlDecodeHandler.h"
+#include "XmlTextHandler.h"
+#include "XmlDocumentHandler.h"
 
 using namespace rapidxml;
 using namespace AutoIt::Common;
@@ -22,6 +32,7 @@ using namespace AutoIt::Common;
 class CompresorXml
 {
 protected:
+	// flagi struktury zapisywane jako bajty w plikach w wersji 0
 	static const char STRING_FLAG = -0x37;
 	static const char FLOAT_FLAG = -0x38;
 	static const char SHORT_FLAG = -0x39;
@@ -34,6 +45,76 @@ protected:
 	static const char CHILDREN_SIGN = -0x46;
 	static const char NODE_END_SIGN = -0x47;
 
+	/// <summary>
+	/// Wersja formatu zapisywana w naglowku: 1 - struktura jako osobny strumien symboli,
+	/// 2 - identyfikator zestawu poczatkowych czestosci modeli po bajcie wersji,
+	/// 3 - identyfikator slownika LZSS po identyfikatorze zestawu czestosci,
+	/// 4 - litery sekcji wartosci kodowane modelem kontekstowym,
+	/// 5 - koder entropijny sekcji LZSS po identyfikatorze slownika,
+	/// 6 - najstarszy bit bajtu kodera oznacza parametry modeli qsmodel sekcji LZSS zapisane za nim,
+	/// 7 - dopasowania z ostatnimi odleglosciami w sekcjach LZSS z modelami qsmodel,
+	/// 8 - ciagi liter z jedna flaga w sekcjach LZSS z modelami qsmodel,
+	/// 9 - przedzialy dlugich odleglosci w sekcjach LZSS z modelami qsmodel,
+	/// 10 - bit LENGTH_CONTEXTS_FLAG bajtu kodera oznacza modele dlugosci w kontekscie dlugosci poprzedniego
+	/// dopasowania w sekcjach LZSS z modelami qsmodel,
+	/// 11 - konteksty symboli struktury ograniczone do najmlodszych bitow identyfikatora nazwy,
+	/// 12 - bit LENGTH_CONTEXTS_FLAG oznacza maske sekcji LZSS z kontekstami modeli dlugosci zapisana za parametrami modeli
+	/// </summary>
+	static const char FORMAT_VERSION = 12;
+
+	/// <summary>
+	/// Bit bajtu kodera entropijnego oznaczajacy, ze za nim zapisana jest maska sekcji LZSS
+	/// z parametrami modeli innymi niz domyslne i parametry kolejnych grup modeli tych sekcji
+	/// </summary>
+	static const unsigned char PARAMETERS_FLAG = 0x80;
+
+	/// <summary>
+	/// Bit bajtu kodera entropijnego oznaczajacy, ze modele dlugosci sekcji LZSS wybierane sa wedlug grupy
+	/// odleglosci i dlugosci poprzedniego dopasowania, a nie wedlug logarytmu odleglosci; od wersji 12
+	/// dotyczy tylko sekcji z maski zapisanej za parametrami modeli
+	/// </summary>
+	static const unsigned char LENGTH_CONTEXTS_FLAG = 0x40;
+
+	/// <summary>
+	/// Wersja formatu odczytywanego pliku; 0 dla plikow bez bajtu wersji
+	/// </summary>
+	char _formatVersion;
+
+	/// <summary>
+	/// Zestaw poczatkowych czestosci modeli uzywany przy kompresji i jedyny dostepny przy dekompresji
+	/// </summary>
+	std::shared_ptr<PriorSet const> _priorSet;
+
+	/// <summary>
+	/// Identyfikator zestawu czestosci odczytywanego pliku
+	/// </summary>
+	int _priorSetId;
+
+	/// <summary>
+	/// Slowniki sekcji LZSS uzywane przy kompresji i jedyne dostepne przy dekompresji
+	/// </summary>
+	std::shared_ptr<LzDictionary const> _dictionary;
+
+	/// <summary>
+	/// Identyfikator slownika odczytywanego pliku
+	/// </summary>
+	int _dictionaryId;
+
+	/// <summary>
+	/// Koder entropijny sekcji LZSS kompresowanych plikow
+	/// </summary>
+	LzssCoder::Backend _backend;
+
+	/// <summary>
+	/// Koder entropijny sekcji LZSS odczytywanego pliku
+	/// </summary>
+	LzssCoder::Backend _archiveBackend;
+
+	/// <summary>
+	/// Czy przy kompresji parametry modeli qsmodel wybierane sa osobno dla kazdej sekcji LZSS
+	/// </summary>
+	bool _parameterSearch;
+
 	/// <summary>
 	/// Struktura reprezentujaca oryginalny plik Xml
 	/// </summary>
@@ -44,6 +125,59 @@ protected:
 	/// </summary>
 	char * _contents;
 
+	/// <summary>
+	/// Kodowanie pierwotnego pliku Xml; pliki UTF-16 sa przed parsowaniem zamieniane na UTF-8
+	/// </summary>
+	TextEncodingDetect::Encoding _sourceEncoding;
+
+	/// <summary>
+	/// Liczba poczatkowych bajtow pliku badanych przy wykrywaniu kodowania
+	/// </summary>
+	static const size_t ENCODING_DETECT_SIZE = 64 << 10;
+
+	/// <summary>
+	/// Minimalny rozmiar fragmentu pliku, dla ktorego oplaca sie parsowanie w osobnym watku
+	/// </summary>
+	static const size_t MIN_SHARD_SIZE = 4 << 20;
+
+	/// <summary>
+	/// Minimalny rozmiar pliku, dla ktorego sekcje kodowane sa w osobnych watkach; mniejsze pliki
+	/// koduja sie krocej, niz trwa uruchomienie watkow
+	/// </summary>
+	static const size_t MIN_STAGE_THREAD_SIZE = 256 << 10;
+
+	/// <summary>
+	/// Dlugosc sparsowanej zawartosci w UTF-8
+	/// </summary>
+	size_t _contentsLength;
+
+	/// <summary>
+	/// Fragment pliku Xml zawierajacy cale rekordy najwyzszego poziomu, parsowany i kodowany
+	/// w osobnym watku z wlasna pula pamieci rapidxml
+	/// </summary>
+	struct XmlShard
+	{
+		/// kopia fragmentu, jezeli nie mozna go zakonczyc w miejscu
+		std::vector<char> text;
+		char * begin;
+		xml_document<> doc;
+		bool parsed;
+		std::vector<int> tokens;
+		std::vector<char> xml;
+		std::string markupValues;
+		std::string attributeValues;
+	};
+
+	/// <summary>
+	/// Fragmenty zawartosci korzenia; puste, jezeli plik parsowany jest w calosci
+	/// </summary>
+	std::vector<std::unique_ptr<XmlShard>> _shards;
+
+	/// <summary>
+	/// Znacznik otwierajacy korzen zamkniety jako pusty wezel, parsowany do _doc przy podziale pliku
+	/// </summary>
+	std::vector<char> _rootShell;
+
 	/// typ mapy haszujacej dla danych z xml wejsciowego
 	typedef std::unordered_map<std::string, int> InputHashMap;
 
@@ -71,26 +205,78 @@ protected:
 	OutputHashMap _outputAttributeNameMap;
 
 	/// <summary>
-	/// Strategia zapisywania i odczytywania znacznikow
+	/// Szerokosc identyfikatorow znacznikow w strukturze pliku
+	/// </summary>
+	ReadStrategy _markupWidth;
+
+	/// <summary>
+	/// Szerokosc identyfikatorow atrybutow w strukturze pliku
+	/// </summary>
+	ReadStrategy _attributeWidth;
+
+	/// <summary>
+	/// Sekcje archiwum kodowane niezaleznie: nazwy znacznikow, nazwy atrybutow, wartosci znacznikow,
+	/// wartosci atrybutow, identyfikatory i bajty wartosci oraz symbole struktury
+	/// </summary>
+	enum Section
+	{
+		MARKUP_NAMES, ATTRIBUTE_NAMES, MARKUP_VALUES, ATTRIBUTE_VALUES, STRUCTURE, TOKENS, SECTION_COUNT
+	};
+
+	/// <summary>
+	/// Kodery sekcji; ich modele i bufory uzywane sa ponownie przez kolejne pliki. Przy kompresji
+	/// kazda sekcja LZSS ma wlasny koder, aby sekcje mogly byc kodowane jednoczesnie.
+	/// </summary>
+	LzssCoder _lzss[TOKENS];
+	StructureTokenCoder _tokenCoder;
+
+	/// <summary>
+	/// Dekodery sekcji, oddzielne od koderow, aby naprzemienna kompresja i dekompresja
+	/// nie tworzyla modeli od nowa przy kazdej zmianie trybu
+	/// </summary>
+	LzssCoder _lzssDecoder;
+	StructureTokenCoder _tokenDecoder;
+
+	/// <summary>
+	/// Parametry modeli sekcji LZSS odczytywanego pliku
+	/// </summary>
+	LzssCoder::ModelParameters _archiveParameters[TOKENS];
+
+	/// <summary>
+	/// Czy modele dlugosci kolejnych sekcji LZSS odczytywanego pliku maja konteksty dlugosci poprzedniego dopasowania
+	/// </summary>
+	bool _archiveLengthContexts[TOKENS];
+
+	/// <summary>
+	/// Skompresowane sekcje kodowanego pliku, laczone w archiwum po zakonczeniu wszystkich etapow
+	/// </summary>
+	std::vector<char> _sections[SECTION_COUNT];
+
+	/// <summary>
+	/// Symbole struktury oraz identyfikatory i bajty wartosci kodowanego pliku; pamiec zachowywana jest miedzy plikami
 	/// </summary>
-	AbstractReadByteStrategy * _markupStrategy;
+	std::vector<int> _tokens;
+	std::vector<char> _structure;
 
 	/// <summary>
-	/// Strategia zapisywania i odczytywania atrybutow
+	/// Zawartosc skompresowanego pliku: budowana w pamieci i zapisywana jednorazowo przy kompresji,
+	/// wczytywana w calosci przy dekompresji
 	/// </summary>
-	AbstractReadByteStrategy * _attributeStrategy;
+	std::vector<char> _archive;
 
 public:
 	/// <summary>
 	/// Inicjalizuje obiekt klasy <see cref="CompresorXml"/>.
 	/// </summary>
-	CompresorXml() : _contents(nullptr)
+	CompresorXml() : _priorSetId(PriorSet::NONE), _dictionaryId(LzDictionary::NONE), _backend(LzssCoder::RANGE_CODER),
+		_archiveBackend(LzssCoder::RANGE_CODER), _parameterSearch(false), _contents(nullptr), _sourceEncoding(TextEncodingDetect::UTF8_NOBOM), _contentsLength(0),
+		_archiveLengthContexts()
 	{
-		valueTypes.push_back(STRING_FLAG);
-		valueTypes.push_back(CHAR_FLAG);
-		valueTypes.push_back(SHORT_FLAG);
-		valueTypes.push_back(FLOAT_FLAG);
-		valueTypes.push_back(INT_FLAG);
+		valueTypes.push_back(char(STRING_FLAG));
+		valueTypes.push_back(char(CHAR_FLAG));
+		valueTypes.push_back(char(SHORT_FLAG));
+		valueTypes.push_back(char(FLOAT_FLAG));
+		valueTypes.push_back(char(INT_FLAG));
 	}
 
 	/// <summary>
@@ -99,7 +285,7 @@ public:
 	~CompresorXml()
 	{
 		if (_contents)
-			delete _contents;
+			delete[] _contents;
 	}
 
 	/// <summary>
@@ -107,18 +293,48 @@ public:
 	/// </summary>
 	/// <param name="source">Sciezka do pliku zrodlowego.</param>
 	/// <param name="target">Sciezka do pliku docelowego.</param>
-	void encode(std::string const & source, std::string const & target)
+	/// <returns><c>true</c> jezeli plik zostal skompresowany</returns>
+	bool encode(std::string const & source, std::string const & target)
 	{
+		bool encoded = true;
 		try
 		{
-			parse(source);
+			if (!parse(source))
+				throw std::runtime_error("Nie mozna odczytac pliku");
 			saveEncodedToBinaryFile(target);
 		}
-		catch (std::runtime_error const & ex)
+		catch (std::exception const & ex)
+		{
+			std::cerr << source << ": " << ex.what() << std::endl;
+			encoded = false;
+		}
+		clearEncoded();
+		return encoded;
+	}
+
+	/// <summary>
+	/// Kompresuje dokument Xml przekazany w pamieci, bez odczytu i zapisu plikow.
+	/// </summary>
+	/// <param name="xml">Zawartosc dokumentu Xml.</param>
+	/// <param name="archive">Zawartosc skompresowanego pliku.</param>
+	void encode(std::vector<char> const & xml, std::vector<char> & archive)
+	{
+		try
+		{
+			size_t length = xml.size();
+			_contents = new char[length + 1];
+			std::copy(xml.begin(), xml.end(), _contents);
+			_contents[length] = '\0';
+			parseContents(length);
+			buildArchive();
+		}
+		catch (...)
 		{
-			std::cout << ex.what() << std::endl;
+			clearEncoded();
+			throw;
 		}
-		delete _contents;
+		clearEncoded();
+		archive.assign(_archive.begin(), _archive.end());
 	}
 
 	/// <summary>
@@ -128,107 +344,512 @@ public:
 	/// <param name="target">Sciezka do pliku docelowego.</param>
 	void decode(std::string const & source, std::string const & target)
 	{
-		std::ifstream file;
-		std::string xml;
-		int pos = 0;
-		LzssCoder lzss;
+		int pos;
+		TextEncodingDetect::Encoding encoding = readHeader(source, pos);
+		BufferedXmlWriter out(target, encoding);
+		XmlTextHandler handler(out);
+		decodeStreams(pos, handler);
+		out.close();
+	}
 
-		file.open(source, std::ios::binary | std::ios::in);
-		ReadStrategy markupNamesSaveStrategy, attributeNamesSaveStrategy;
-		file.read((char*)&markupNamesSaveStrategy, sizeof(char));
-		file.read((char*)&attributeNamesSaveStrategy, sizeof(char));
-		pos = file.tellg();
+	/// <summary>
+	/// Dekompresuje plik skompresowany przekazany w pamieci do tekstu Xml w kodowaniu pliku pierwotnego.
+	/// </summary>
+	/// <param name="archive">Zawartosc skompresowanego pliku.</param>
+	/// <param name="xml">Zawartosc dokumentu Xml.</param>
+	void decode(std::vector<char> const & archive, std::string & xml)
+	{
+		_archive.assign(archive.begin(), archive.end());
+		int pos;
+		TextEncodingDetect::Encoding encoding = parseHeader(pos);
+		xml.clear();
+		BufferedXmlWriter out(xml, encoding);
+		XmlTextHandler handler(out);
+		decodeStreams(pos, handler);
+		out.close();
+	}
+
+	/// <summary>
+	/// Ustawia zestaw poczatkowych czestosci modeli dla kolejnych plikow; nullptr przywraca rozklad rownomierny.
+	/// Zestaw jest tez jedynym, ktorego moga uzywac dekompresowane pliki.
+	/// </summary>
+	void setPriorSet(std::shared_ptr<PriorSet const> priorSet)
+	{
+		_priorSet = priorSet;
+	}
+
+	/// <summary>
+	/// Ustawia slowniki sekcji LZSS dla kolejnych plikow; nullptr wylacza slowniki.
+	/// Zestaw jest tez jedynym, ktorego moga uzywac dekompresowane pliki.
+	/// </summary>
+	void setDictionary(std::shared_ptr<LzDictionary const> dictionary)
+	{
+		_dictionary = dictionary;
+		for (int i = 0; i < TOKENS; ++i)
+			_lzss[i].setDictionary(_dictionary ? _dictionary->section(i) : nullptr);
+	}
+
+	/// <summary>
+	/// Wybiera koder entropijny sekcji LZSS kolejnych plikow; dekompresja uzywa kodera zapisanego w naglowku.
+	/// </summary>
+	void setBackend(LzssCoder::Backend backend)
+	{
+		_backend = backend;
+	}
+
+	/// <summary>
+	/// Wlacza wybor parametrow modeli qsmodel kazdej sekcji LZSS kolejnych plikow na poczatku jej danych.
+	/// Wybrane parametry zapisywane sa w naglowku; kompresja trwa dluzej, dekompresja nie.
+	/// </summary>
+	void setParameterSearch(bool enabled)
+	{
+		_parameterSearch = enabled;
+	}
+
+	/// <summary>
+	/// Kompresuje plik bez zapisu wyniku, dodajac wystapienia symboli kazdej sekcji LZSS do licznikow.
+	/// </summary>
+	/// <param name="source">Sciezka do pliku zrodlowego.</param>
+	/// <param name="statistics">Liczniki kolejnych sekcji, uzupelniane do ich liczby.</param>
+	/// <returns><c>true</c> jezeli plik zostal przetworzony</returns>
+	bool collectStatistics(std::string const & source, std::vector<LzssCoder::Frequencies> & statistics)
+	{
+		statistics.resize(TOKENS);
+		for (int i = 0; i < TOKENS; ++i)
+			_lzss[i].setStatistics(&statistics[i]);
+		bool encoded = encodeWithoutSaving(source);
+		for (auto & coder : _lzss)
+			coder.setStatistics(nullptr);
+		return encoded;
+	}
+
+	/// <summary>
+	/// Kompresuje plik bez zapisu wyniku, dodajac dane wejsciowe kazdej sekcji LZSS do probek slownika.
+	/// </summary>
+	/// <param name="source">Sciezka do pliku zrodlowego.</param>
+	/// <param name="samples">Probki kolejnych sekcji, uzupelniane do ich liczby.</param>
+	/// <returns><c>true</c> jezeli plik zostal przetworzony</returns>
+	bool collectSamples(std::string const & source, std::vector<std::vector<std::string>> & samples)
+	{
+		samples.resize(TOKENS);
+		for (int i = 0; i < TOKENS; ++i)
+			_lzss[i].setSamples(&samples[i]);
+		bool encoded = encodeWithoutSaving(source);
+		for (auto & coder : _lzss)
+			coder.setSamples(nullptr);
+		return encoded;
+	}
+
+	/// <summary>
+	/// Dekompresuje plik XML z zrodla binarnego, przekazujac kolejne wezly, atrybuty i wartosci
+	/// do odbiorcy zdarzen zamiast tworzenia tekstu Xml. Wartosci liczbowe przekazywane sa jako liczby.
+	/// </summary>
+	/// <param name="source">Sciezka do pliku zrodlowego.</param>
+	/// <param name="handler">Odbiorca zdarzen.</param>
+	void decode(std::string const & source, AbstractXmlDecodeHandler & handler)
+	{
+		int pos;
+		readHeader(source, pos);
+		decodeStreams(pos, handler);
+	}
+
+	/// <summary>
+	/// Dekompresuje plik XML bezposrednio do drzewa rapidxml, bez tworzenia i ponownego parsowania tekstu.
+	/// Wezly i wartosci alokowane sa z puli pamieci dokumentu, ktory zostaje wczesniej wyczyszczony.
+	/// </summary>
+	/// <param name="source">Sciezka do pliku zrodlowego.</param>
+	/// <param name="doc">Dokument docelowy.</param>
+	void decodeToDocument(std::string const & source, xml_document<> & doc)
+	{
+		int pos;
+		readHeader(source, pos);
+		doc.clear();
+		XmlDocumentHandler handler(doc);
+		decodeStreams(pos, handler);
+	}
+
+private:
+	/// <summary>
+	/// Kompresuje plik do pamieci na potrzeby uczenia i zwalnia wynik.
+	/// </summary>
+	/// <returns><c>true</c> jezeli plik zostal przetworzony</returns>
+	bool encodeWithoutSaving(std::string const & source)
+	{
+		bool encoded = true;
+		try
+		{
+			if (!parse(source))
+				throw std::runtime_error("Nie mozna odczytac pliku");
+			buildArchive();
+		}
+		catch (std::exception const & ex)
+		{
+			std::cerr << source << ": " << ex.what() << std::endl;
+			encoded = false;
+		}
+		clearEncoded();
+		return encoded;
+	}
+
+	/// <summary>
+	/// Zwalnia zawartosc i drzewo kodowanego pliku, zachowujac pamiec koderow dla kolejnych plikow.
+	/// </summary>
+	void clearEncoded()
+	{
+		delete[] _contents;
+		_contents = nullptr;
+		_contentsLength = 0;
+		_shards.clear();
+		_rootShell.clear();
+		_doc.clear();
+		_inputMarkupNameMap.clear();
+		_inputAttributeNameMap.clear();
+	}
+
+	/// <summary>
+	/// Wczytuje skompresowany plik do pamieci i odczytuje jego naglowek wraz z szerokosciami identyfikatorow.
+	/// </summary>
+	/// <param name="source">Sciezka do pliku zrodlowego.</param>
+	/// <param name="pos">Pozycja za naglowkiem.</param>
+	/// <returns>Kodowanie pliku pierwotnego</returns>
+	TextEncodingDetect::Encoding readHeader(std::string const & source, int & pos)
+	{
+		std::ifstream file(source, std::ios::binary | std::ios::ate);
+		if (!file)
+			throw std::runtime_error("Nie mozna otworzyc pliku " + source);
+		_archive.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(_archive.data(), _archive.size());
 		file.close();
+		return parseHeader(pos);
+	}
 
-		_markupStrategy = ReadByteStrategyFactory::Instance().create(markupNamesSaveStrategy);
-		_attributeStrategy = ReadByteStrategyFactory::Instance().create(attributeNamesSaveStrategy);
-		
-		lzss.changePositionForRangeCoder(file, source, pos);
-		std::string markupNames = lzss.decode(source, pos);
+	/// <summary>
+	/// Odczytuje naglowek pliku wczytanego do _archive wraz z szerokosciami identyfikatorow.
+	/// </summary>
+	/// <param name="pos">Pozycja za naglowkiem.</param>
+	/// <returns>Kodowanie pliku pierwotnego</returns>
+	TextEncodingDetect::Encoding parseHeader(int & pos)
+	{
+		if (_archive.size() < 3)
+			throw std::runtime_error("Niepoprawny plik skompresowany");
+
+		_markupWidth = static_cast<ReadStrategy>(_archive[0]);
+		_attributeWidth = static_cast<ReadStrategy>(_archive[1]);
+		if (!isIdWidth(_markupWidth) || !isIdWidth(_attributeWidth))
+			throw std::runtime_error("Niepoprawna szerokosc identyfikatorow");
+		pos = 2;
+		// bajt kodowania i bajt wersji; starsze pliki zaczynaja w ich miejscu pierwsza sekcje range codera
+		char encoding = _archive[pos];
+		_formatVersion = 0;
+		if (encoding >= TextEncodingDetect::None && encoding <= TextEncodingDetect::UTF16_BE_NOBOM)
+		{
+			++pos;
+			if (pos < (int)_archive.size() && _archive[pos] != '!')
+				_formatVersion = _archive[pos++];
+		}
+		else
+			encoding = TextEncodingDetect::UTF8_NOBOM;
+		_priorSetId = PriorSet::NONE;
+		if (_formatVersion >= 2 && pos < (int)_archive.size())
+			_priorSetId = static_cast<unsigned char>(_archive[pos++]);
+		if (_priorSetId != PriorSet::NONE && (!_priorSet || _priorSet->id() != _priorSetId))
+			throw std::runtime_error("Brak zestawu czestosci o identyfikatorze " + std::to_string(_priorSetId));
+		_dictionaryId = LzDictionary::NONE;
+		if (_formatVersion >= 3 && pos < (int)_archive.size())
+			_dictionaryId = static_cast<unsigned char>(_archive[pos++]);
+		if (_dictionaryId != LzDictionary::NONE && (!_dictionary || _dictionary->id() != _dictionaryId))
+			throw std::runtime_error("Brak slownika o identyfikatorze " + std::to_string(_dictionaryId));
+		_archiveBackend = LzssCoder::RANGE_CODER;
+		bool hasParameters = false;
+		bool hasLengthContexts = false;
+		if (_formatVersion >= 5 && pos < (int)_archive.size())
+		{
+			unsigned char backend = _archive[pos++];
+			hasParameters = _formatVersion >= 6 && (backend & PARAMETERS_FLAG);
+			hasLengthContexts = _formatVersion >= 10 && (backend & LENGTH_CONTEXTS_FLAG);
+			if (hasParameters)
+				backend &= ~PARAMETERS_FLAG;
+			if (hasLengthContexts)
+				backend &= ~LENGTH_CONTEXTS_FLAG;
+			_archiveBackend = static_cast<LzssCoder::Backend>(backend);
+		}
+		if (_archiveBackend != LzssCoder::RANGE_CODER && _archiveBackend != LzssCoder::BINARY_CODER
+			&& _archiveBackend != LzssCoder::RANS_CODER && _archiveBackend != LzssCoder::HUFFMAN_CODER
+			&& _archiveBackend != LzssCoder::WIDE_RANGE_CODER)
+			throw std::runtime_error("Nieznany koder entropijny " + std::to_string(_archiveBackend));
+		// maska sekcji z parametrami innymi niz domyslne i bajty parametrow kolejnych grup modeli tych sekcji
+		for (auto & parameters : _archiveParameters)
+			parameters = LzssCoder::ModelParameters();
+		if (hasParameters && pos < (int)_archive.size())
+		{
+			unsigned char mask = _archive[pos++];
+			for (int section = 0; section < TOKENS; ++section)
+			{
+				if (!(mask >> section & 1))
+					continue;
+				if (pos + LzssCoder::MODEL_GROUP_COUNT > (int)_archive.size())
+					throw std::runtime_error("Niepoprawny plik skompresowany");
+				for (auto & group : _archiveParameters[section].groups)
+				{
+					group = static_cast<unsigned char>(_archive[pos++]);
+					if (!LzssCoder::ModelParameters::isValid(group))
+						throw std::runtime_error("Niepoprawne parametry modeli sekcji " + std::to_string(section));
+				}
+			}
+		}
+		// maska sekcji z kontekstami modeli dlugosci; w wersjach 10 i 11 bit dotyczyl wszystkich sekcji
+		unsigned char lengthMask = hasLengthContexts ? 0xFF : 0;
+		if (hasLengthContexts && _formatVersion >= 12)
+		{
+			if (pos >= (int)_archive.size())
+				throw std::runtime_error("Niepoprawny plik skompresowany");
+			lengthMask = _archive[pos++];
+		}
+		for (int section = 0; section < TOKENS; ++section)
+			_archiveLengthContexts[section] = (lengthMask >> section & 1) != 0;
+		return static_cast<TextEncodingDetect::Encoding>(encoding);
+	}
+
+	/// <summary>
+	/// Dekompresuje sekcje nazw, wartosci i struktury, a nastepnie odtwarza z nich dokument.
+	/// </summary>
+	/// <param name="pos">Pozycja pierwszej sekcji w pliku wczytanym przez readHeader.</param>
+	/// <param name="handler">Odbiorca zdarzen.</param>
+	template <class Handler>
+	void decodeStreams(int pos, Handler & handler)
+	{
+		std::vector<char> const & source = _archive;
+
+		std::string markupNames = decodeSection(MARKUP_NAMES, pos);
 		readMap(_outputMarkupNameMap, markupNames);
 
-		lzss.changePositionForRangeCoder(file, source, pos);
-		std::string attributeNames = lzss.decode(source, pos);
+		std::string attributeNames = decodeSection(ATTRIBUTE_NAMES, pos);
 		readMap(_outputAttributeNameMap, attributeNames);
-		
-		lzss.changePositionForRangeCoder(file, source, pos);
-		std::string markupValueSource = lzss.decode(source, pos);
-
-		lzss.changePositionForRangeCoder(file, source, pos);
-		std::string attributeValueSource = lzss.decode(source, pos);
-		
-		lzss.changePositionForRangeCoder(file, source, pos);
-		std::string byteStr = lzss.decode(source, pos);
-		int index = 0, markupValueSourcePos = 0, attributeValueSourcePos = 0;
-		std::stack<std::string> lastOpenedNodes;
-		readXml(byteStr, xml, index, markupValueSource, attributeValueSource,
-			markupValueSourcePos, attributeValueSourcePos, lastOpenedNodes, 0);
+		prepareNames(handler);
 
-		std::ofstream out(target);
-		out << xml;
-		out.close();
+		std::string markupValueSource = decodeSection(MARKUP_VALUES, pos);
+		std::string attributeValueSource = decodeSection(ATTRIBUTE_VALUES, pos);
+		std::string byteStr = decodeSection(STRUCTURE, pos);
+		if (_formatVersion == 0)
+		{
+			dispatchWidths(_markupWidth, _attributeWidth, [&](auto markupBytes, auto attributeBytes)
+			{
+				readLegacyXml<decltype(markupBytes), decltype(attributeBytes)>(byteStr, handler, markupValueSource, attributeValueSource);
+			});
+		}
+		else
+		{
+			StructureTokenCoder & tokens = _tokenDecoder;
+			_lzssDecoder.changePositionForRangeCoder(source, pos);
+			tokens.setWideRangeCoder(_archiveBackend == LzssCoder::WIDE_RANGE_CODER);
+			tokens.setBoundedContexts(_formatVersion >= 11);
+			tokens.startDecoding(source, pos);
+			dispatchWidths(_markupWidth, _attributeWidth, [&](auto markupBytes, auto attributeBytes)
+			{
+				readXml<decltype(markupBytes), decltype(attributeBytes)>(tokens, byteStr, handler, markupValueSource, attributeValueSource);
+			});
+			tokens.doneDecoding(pos);
+		}
 
 		_outputAttributeNameMap.clear();
 		_outputMarkupNameMap.clear();
 	}
 
-private:
+	/// <summary>
+	/// Dekompresuje kolejna sekcje LZSS z czestosciami poczatkowymi i slownikiem wskazanymi w naglowku.
+	/// </summary>
+	/// <param name="section">Sekcja archiwum.</param>
+	/// <param name="pos">Pozycja w pliku, zostaje przesunieta za sekcje.</param>
+	std::string decodeSection(Section section, int & pos)
+	{
+		_lzssDecoder.setPrior(_priorSetId != PriorSet::NONE ? _priorSet->section(section) : nullptr);
+		_lzssDecoder.setDictionary(_dictionaryId != LzDictionary::NONE ? _dictionary->section(section) : nullptr);
+		_lzssDecoder.setLiteralContexts(_formatVersion >= 4 && hasLiteralContexts(section));
+		_lzssDecoder.setBackend(_archiveBackend);
+		_lzssDecoder.setParameters(_archiveParameters[section]);
+		_lzssDecoder.setRepeatOffsets(_formatVersion >= 7);
+		_lzssDecoder.setLiteralRuns(_formatVersion >= 8);
+		_lzssDecoder.setOffsetSlots(_formatVersion >= 9);
+		_lzssDecoder.setLengthContexts(_archiveLengthContexts[section]);
+		_lzssDecoder.changePositionForRangeCoder(_archive, pos);
+		return _lzssDecoder.decode(_archive, pos);
+	}
+
+	/// <summary>
+	/// Przekazuje odczytane mapy nazw odbiorcom, ktorzy ich potrzebuja przed pierwszym zdarzeniem.
+	/// </summary>
+	template <class Handler>
+	void prepareNames(Handler & /*handler*/)
+	{
+	}
+
+	void prepareNames(XmlDocumentHandler & handler)
+	{
+		handler.setNames(_outputMarkupNameMap, _outputAttributeNameMap);
+	}
+
 	/// <summary>
 	/// Zapsuje plik xml do skompresowanej, binarnej postaci
 	/// </summary>
 	/// <param name="filePath">Sciezka do pliku.</param>
 	void saveEncodedToBinaryFile(std::string const & filePath)
 	{
+		buildArchive();
 		std::ofstream file(filePath, std::ios::binary);
-		LzssCoder lzss;
+		file.write(_archive.data(), _archive.size());
+		if (!file)
+			throw std::runtime_error("Nie mozna zapisac pliku " + filePath);
+	}
 
+	/// <summary>
+	/// Buduje w _archive skompresowana postac sparsowanego dokumentu. Sekcje duzych dokumentow kodowane sa
+	/// w osobnych watkach: sekcje nazw w trakcie zapisu struktury, a sekcje wartosci i struktury po jego zakonczeniu.
+	/// </summary>
+	void buildArchive()
+	{
 		auto root = _doc.first_node();
 		int markupNameCounter = 0, attributeCounter = 0;
 		namesToHashMaps(root, markupNameCounter, attributeCounter);
+		for (auto const & shard : _shards)
+			namesToHashMaps(shard->doc.first_node(), markupNameCounter, attributeCounter);
 
-		ReadStrategy markupStr, attrStr;
-		if (_inputMarkupNameMap.size() <= CHAR_MAX)
-			markupStr = ReadStrategy::Char;
-		else if (_inputMarkupNameMap.size() <= SHRT_MAX)
-			markupStr = ReadStrategy::Short;
-		else
-			markupStr = ReadStrategy::Int;
-
-		if (_inputAttributeNameMap.size() <= CHAR_MAX)
-			attrStr = ReadStrategy::Char;
-		else if (_inputAttributeNameMap.size() <= SHRT_MAX)
-			attrStr = ReadStrategy::Short;
-		else
-			attrStr = ReadStrategy::Int;
-		_markupStrategy = ReadByteStrategyFactory::Instance().create(markupStr);
-		_attributeStrategy = ReadByteStrategyFactory::Instance().create(attrStr);
+		_markupWidth = idWidth(_inputMarkupNameMap.size());
+		_attributeWidth = idWidth(_inputAttributeNameMap.size());
 
-		file.write((char*)&markupStr, sizeof(char));
-		file.write((char*)&attrStr, sizeof(char));
-		file.close();
+		// nazwy sa znane przed zapisem struktury, wiec ich sekcje kodowane sa w trakcie jej tworzenia
+		std::vector<std::string> markups;
+		saveMap(_inputMarkupNameMap, markups);
+		std::vector<std::string> attributes;
+		saveMap(_inputAttributeNameMap, attributes);
+		std::vector<std::thread> stages;
+		bool threaded = _contentsLength >= MIN_STAGE_THREAD_SIZE;
+		auto startStage = [&stages, threaded](auto stage)
+		{
+			if (threaded)
+				stages.emplace_back(stage);
+			else
+				stage();
+		};
+		startStage([this, &markups]() { encodeSection(MARKUP_NAMES, markups); });
+		startStage([this, &attributes]() { encodeSection(ATTRIBUTE_NAMES, attributes); });
 
-		std::vector<char> * xml = new std::vector<char>();
+		_tokens.clear();
+		_structure.clear();
 		std::string markupValues;
 		std::string attributeValues;
-		saveXml(root, *xml, markupValues, attributeValues);
+		try
+		{
+			dispatchWidths(_markupWidth, _attributeWidth, [&](auto markupBytes, auto attributeBytes)
+			{
+				typedef decltype(markupBytes) MarkupBytes;
+				typedef decltype(attributeBytes) AttributeBytes;
+				if (_shards.empty())
+					saveXml<MarkupBytes, AttributeBytes>(root, _tokens, _structure, markupValues, attributeValues);
+				else
+					saveShardedXml<MarkupBytes, AttributeBytes>(root, _tokens, _structure, markupValues, attributeValues);
+			});
+		}
+		catch (...)
+		{
+			for (auto & stage : stages)
+				stage.join();
+			throw;
+		}
 
-		std::vector<std::string> markups;
-		saveMap(_inputMarkupNameMap, markups);
-		lzss.encode(markups, filePath);
+		startStage([this, &markupValues]() { encodeSection(MARKUP_VALUES, markupValues); });
+		startStage([this, &attributeValues]() { encodeSection(ATTRIBUTE_VALUES, attributeValues); });
+		startStage([this]() { encodeSection(STRUCTURE, _structure); });
+		_sections[TOKENS].clear();
+		_tokenCoder.setWideRangeCoder(_backend == LzssCoder::WIDE_RANGE_CODER);
+		_tokenCoder.setBoundedContexts(true);
+		_tokenCoder.encode(_tokens, _sections[TOKENS]);
+		for (auto & stage : stages)
+			stage.join();
 
-		std::vector<std::string> attributes;
-		saveMap(_inputAttributeNameMap, attributes);
-		lzss.encode(attributes, filePath);
+		_archive.clear();
+		_archive.push_back(static_cast<char>(_markupWidth));
+		_archive.push_back(static_cast<char>(_attributeWidth));
+		_archive.push_back(static_cast<char>(_sourceEncoding));
+		_archive.push_back(char(FORMAT_VERSION));
+		_archive.push_back(static_cast<char>(_priorSet ? _priorSet->id() : PriorSet::NONE));
+		_archive.push_back(static_cast<char>(_dictionary ? _dictionary->id() : LzDictionary::NONE));
+		unsigned char mask = 0;
+		unsigned char lengthMask = 0;
+		for (int section = 0; section < TOKENS; ++section)
+		{
+			mask |= (_lzss[section].parameters().isDefault() ? 0 : 1) << section;
+			lengthMask |= (_lzss[section].lengthContexts() ? 1 : 0) << section;
+		}
+		unsigned char backend = _backend;
+		if (mask)
+			backend |= PARAMETERS_FLAG;
+		if (lengthMask)
+			backend |= LENGTH_CONTEXTS_FLAG;
+		_archive.push_back(static_cast<char>(backend));
+		if (mask)
+			_archive.push_back(static_cast<char>(mask));
+		for (int section = 0; section < TOKENS; ++section)
+		{
+			if (mask >> section & 1)
+				_archive.insert(_archive.end(), _lzss[section].parameters().groups, _lzss[section].parameters().groups + LzssCoder::MODEL_GROUP_COUNT);
+		}
+		if (lengthMask)
+			_archive.push_back(static_cast<char>(lengthMask));
+		for (auto const & section : _sections)
+			_archive.insert(_archive.end(), section.begin(), section.end());
+	}
 
-		lzss.encode(markupValues, filePath);
-		lzss.encode(attributeValues, filePath);
+	/// <summary>
+	/// Kompresuje jedna sekcje LZSS jej wlasnym koderem do jej wlasnego bufora.
+	/// </summary>
+	/// <param name="section">Sekcja archiwum.</param>
+	/// <param name="source">Zrodlo znakow.</param>
+	template <class Source>
+	void encodeSection(Section section, Source const & source)
+	{
+		_sections[section].clear();
+		_lzss[section].setPrior(_priorSet ? _priorSet->section(section) : nullptr);
+		_lzss[section].setLiteralContexts(hasLiteralContexts(section));
+		_lzss[section].setBackend(_backend);
+		_lzss[section].setParameters(LzssCoder::ModelParameters());
+		_lzss[section].setParameterSearch(_parameterSearch);
+		_lzss[section].setRepeatOffsets(true);
+		_lzss[section].setLiteralRuns(true);
+		_lzss[section].setOffsetSlots(true);
+		_lzss[section].setLengthContexts(false);
+		_lzss[section].setLengthContextSearch(true);
+		_lzss[section].encode(source, _sections[section]);
+	}
 
-		lzss.encode(*xml, filePath);
+	/// <summary>
+	/// Czy litery sekcji kodowane sa modelem kontekstowym. Dotyczy sekcji tekstu wartosci, w ktorych
+	/// wiekszosc bajtow zapisywana jest jako litery; w pozostalych sekcjach przewazaja dopasowania.
+	/// </summary>
+	static bool hasLiteralContexts(Section section)
+	{
+		return section == MARKUP_VALUES || section == ATTRIBUTE_VALUES;
+	}
 
-		delete xml;
-		delete _markupStrategy, _attributeStrategy;
-		_inputMarkupNameMap.clear();
-		_inputAttributeNameMap.clear();
+	/// <summary>
+	/// Dobiera najmniejsza szerokosc identyfikatorow mieszczaca podana liczbe nazw.
+	/// </summary>
+	/// <param name="count">Liczba roznych nazw.</param>
+	ReadStrategy idWidth(size_t count)
+	{
+		if (count <= CHAR_MAX)
+			return ReadStrategy::Char;
+		else if (count <= SHRT_MAX)
+			return ReadStrategy::Short;
+		return ReadStrategy::Int;
+	}
+
+	/// <summary>
+	/// Czy bajt naglowka jest jedna z szerokosci identyfikatorow zwracanych przez idWidth.
+	/// </summary>
+	static bool isIdWidth(ReadStrategy width)
+	{
+		return width == ReadStrategy::Char || width == ReadStrategy::Short || width == ReadStrategy::Int;
 	}
 
 	/// <summary>
@@ -238,28 +859,158 @@ private:
 	/// <returns></returns>
 	bool parse(std::string const & filePath)
 	{
-		_contents = xmlToChar(filePath);
+		size_t length;
+		_contents = xmlToChar(filePath, length);
 		if (_contents == nullptr)
 			return false;
+		return parseContents(length);
+	}
+
+	/// <summary>
+	/// Sparsowanie zawartosci wczytanej do _contents
+	/// </summary>
+	/// <param name="length">Dlugosc zawartosci.</param>
+	bool parseContents(size_t length)
+	{
+		transcodeToUtf8(length);
+		_contentsLength = length;
+		if (splitIntoShards(length))
+			return parseShards();
+		_doc.parse<0>(_contents);
+		return true;
+	}
+
+	/// <summary>
+	/// Wykrywa kodowanie wczytanego pliku i zamienia zawartosc UTF-16 na UTF-8, ktory obsluguje parser.
+	/// </summary>
+	/// <param name="length">Dlugosc zawartosci pliku, zostaje zmieniona.</param>
+	void transcodeToUtf8(size_t & length)
+	{
+		TextEncodingDetect detector;
+		unsigned char const * bytes = reinterpret_cast<unsigned char const *>(_contents);
+		_sourceEncoding = detector.DetectEncoding(bytes, std::min<size_t>(length, size_t(ENCODING_DETECT_SIZE)));
+		if (!isUtf16(_sourceEncoding))
+			return;
+		size_t bomLength = TextEncodingDetect::GetBOMLengthFromEncodingMode(_sourceEncoding);
+		char * utf8 = new char[Utf16Transcoder::maxUtf8Length(length - bomLength) + 1];
+		length = Utf16Transcoder::toUtf8(bytes + bomLength, length - bomLength, isBigEndian(_sourceEncoding), utf8);
+		utf8[length] = '\0';
+		delete[] _contents;
+		_contents = utf8;
+	}
+
+	bool isUtf16(TextEncodingDetect::Encoding encoding)
+	{
+		return encoding == TextEncodingDetect::UTF16_LE_BOM || encoding == TextEncodingDetect::UTF16_LE_NOBOM
+			|| isBigEndian(encoding);
+	}
+
+	bool isBigEndian(TextEncodingDetect::Encoding encoding)
+	{
+		return encoding == TextEncodingDetect::UTF16_BE_BOM || encoding == TextEncodingDetect::UTF16_BE_NOBOM;
+	}
+
+	/// <summary>
+	/// Dzieli zawartosc korzenia na fragmenty wedlug granic rekordow najwyzszego poziomu.
+	/// Kazdy fragment zostaje zakonczony znakiem '\0' w miejscu lub skopiowany do wlasnego bufora.
+	/// </summary>
+	/// <param name="length">Dlugosc zawartosci pliku.</param>
+	/// <returns><c>true</c> jezeli plik zostal podzielony</returns>
+	bool splitIntoShards(size_t length)
+	{
+		size_t shardCount = std::min<size_t>(std::thread::hardware_concurrency(), length / MIN_SHARD_SIZE);
+		XmlRecordSplitter splitter;
+		XmlRecordSplitter::Range rootTag;
+		std::vector<XmlRecordSplitter::Range> ranges;
+		if (!splitter.split(_contents, length, shardCount, rootTag, ranges))
+			return false;
+
+		_rootShell.assign(_contents + rootTag.begin, _contents + rootTag.end);
+		_rootShell.push_back('/');
+		_rootShell.push_back('>');
+		_rootShell.push_back('\0');
+
+		// fragment konczy sie w miejscu, jezeli nastepujacy po nim znak jest bialy;
+		// kopie musza powstac przed wpisaniem jakiegokolwiek terminatora
+		std::vector<bool> terminatedInPlace(ranges.size());
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			std::unique_ptr<XmlShard> shard(new XmlShard());
+			char terminator = _contents[ranges[i].end];
+			terminatedInPlace[i] = i + 1 == ranges.size() || isspace((unsigned char)terminator);
+			size_t begin = ranges[i].begin + (i > 0 && terminatedInPlace[i - 1] ? 1 : 0);
+			if (terminatedInPlace[i])
+			{
+				shard->begin = _contents + begin;
+			}
+			else
+			{
+				shard->text.assign(_contents + begin, _contents + ranges[i].end);
+				shard->text.push_back('\0');
+				shard->begin = shard->text.data();
+			}
+			_shards.push_back(std::move(shard));
+		}
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (terminatedInPlace[i])
+				_contents[ranges[i].end] = '\0';
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Parsuje fragmenty pliku rownolegle; znacznik korzenia parsowany jest w biezacym watku.
+	/// </summary>
+	/// <returns><c>true</c> jezeli wszystkie fragmenty zostaly sparsowane</returns>
+	bool parseShards()
+	{
+		std::vector<std::thread> workers;
+		for (auto const & shard : _shards)
+		{
+			XmlShard * current = shard.get();
+			workers.emplace_back([current]()
+			{
+				try
+				{
+					current->doc.parse<0>(current->begin);
+					current->parsed = true;
+				}
+				catch (...)
+				{
+					current->parsed = false;
+				}
+			});
+		}
 		try
 		{
-			_doc.parse<0>(_contents);
-			return true;
+			_doc.parse<0>(_rootShell.data());
+		}
+		catch (...)
+		{
+			for (auto & worker : workers)
+				worker.join();
+			throw;
 		}
-		catch (rapidxml::parse_error const & e)
+		for (auto & worker : workers)
+			worker.join();
+		for (auto const & shard : _shards)
 		{
-			return true;
+			if (!shard->parsed)
+				throw std::runtime_error("Nie udalo sie sparsowac fragmentu pliku Xml");
 		}
+		return true;
 	}
 
 	/// <summary>
 	/// Zapis pliku xml do lancucha znakow, konieczny dla biblioteki rapidxml
 	/// </summary>
 	/// <param name="stageFile">Sciezka do pliku.</param>
+	/// <param name="length">Liczba wczytanych znakow.</param>
 	/// <returns></returns>
-	char * xmlToChar(std::string const & stageFile)
+	char * xmlToChar(std::string const & stageFile, size_t & length)
 	{
-		std::ifstream file(stageFile);
+		std::ifstream file(stageFile, std::ios::binary);
 		if (file.fail())
 			return nullptr;
 		std::filebuf * pbuf = file.rdbuf();
@@ -267,18 +1018,25 @@ private:
 		file.seekg(0);
 		char * out = new char[fileLength + 1];
 		file.read(out, fileLength);
+		length = static_cast<size_t>(file.gcount());
+		out[length] = '\0';
 		return out;
 	}
 
 	/// <summary>
 	/// Zapisuje wszystkie nazwy znacznikow w xmlu jako liczby do mapy.
+	/// Drzewo przechodzone jest iteracyjnie (preorder) z uzyciem jawnego stosu.
 	/// </summary>
 	/// <param name="firstNode">The first node.</param>
 	void namesToHashMaps(xml_node<> * firstNode, int & markupNameCounter, int & attributeCounter)
 	{
-		// wezly
-		for (xml_node<>* node = firstNode; node; node = node->next_sibling())
+		std::stack<xml_node<>*> nodesToVisit;
+		if (firstNode != NULL)
+			nodesToVisit.push(firstNode);
+		while (!nodesToVisit.empty())
 		{
+			xml_node<>* node = nodesToVisit.top();
+			nodesToVisit.pop();
 			// znacznik
 			std::string nodeName = node->name();
 			if (!nodeName.empty() && _inputMarkupNameMap.find(nodeName) == _inputMarkupNameMap.end())
@@ -291,24 +1049,32 @@ private:
 				if (!attrName.empty() && _inputAttributeNameMap.find(attrName) == _inputAttributeNameMap.end())
 					_inputAttributeNameMap[attrName] = attributeCounter++;
 			}
+			// rodzenstwo odwiedzane po dzieciach, wiec trafia na stos jako pierwsze
+			auto nextSibling = node->next_sibling();
+			if (nextSibling != NULL)
+				nodesToVisit.push(nextSibling);
 			// dzieci w wezle
 			auto firstChild = node->first_node();
 			if (firstChild != NULL)
-				namesToHashMaps(firstChild, markupNameCounter, attributeCounter);
+				nodesToVisit.push(firstChild);
 		}
 	}
 
 	/// <summary>
-	/// Zapisuje mape do postaci wektora stringow.
+	/// Zapisuje mape do postaci wektora stringow, w kolejnosci identyfikatorow, aby wynik
+	/// nie zalezal od kolejnosci elementow mapy haszujacej.
 	/// </summary>
 	/// <param name="map">Mapa.</param>
 	/// <param name="names">Wyjsciowy wektor.</param>
 	void saveMap(InputHashMap const & map, std::vector<std::string> & names)
 	{
+		std::vector<std::string const *> byId(map.size());
 		for (InputHashMap::const_iterator it = map.begin(); it != map.end(); ++it)
+			byId[it->second] = &it->first;
+		for (size_t id = 0; id < byId.size(); ++id)
 		{
-			names.push_back(std::to_string(it->second));
-			names.push_back(it->first);
+			names.push_back(std::to_string(id));
+			names.push_back(*byId[id]);
 		}
 	}
 
@@ -366,27 +1132,14 @@ private:
 	}
 
 	/// <summary>
-	/// Zmienia wartosc typu float na ciag bajtow.
-	/// </summary>
-	/// <param name="paramFloat">Float wejsciowy.</param>
-	/// <returns>Ciag bajtow reprezentujacy float</returns>
-	std::vector<char> floatToBytes(float paramFloat)
-	{
-		unsigned char* p = reinterpret_cast<unsigned char*>(&paramFloat);
-		std::vector<char> arrayOfBytes(p, p + 4);
-		return arrayOfBytes;
-	}
-
-	/// <summary>
-	/// Determinuje jaki typ wartosci posiada string i zmiana go na zbiot bajtow oraz zwraca odpowiednia flage do referencji flag.
+	/// Determinuje jaki typ wartosci posiada string i zapisuje bajty wartosci.
 	/// </summary>
 	/// <param name="str">String wejsciowy.</param>
-	/// <param name="flag">Zwracana flaga wartosci.</param>
-	/// <returns></returns>
-	std::vector<char> stringToValues(std::string const & str, char & flag)
+	/// <param name="xml">Strumien identyfikatorow i bajtow wartosci.</param>
+	/// <returns>Symbol typu wartosci; dla TOKEN_STRING tekst nalezy dopisac do zrodla wartosci</returns>
+	StructureToken saveValue(std::string const & str, std::vector<char> & xml)
 	{
-		std::vector<char> bytes;
-		flag = STRING_FLAG;
+		StructureToken flag = TOKEN_STRING;
 		float f;
 		int i;
 		bool isFloat = tryParseToFloat(str, f);
@@ -396,88 +1149,91 @@ private:
 			if (isInteger)
 			{
 				i = f;
-				if (i >= -256 && i <= 255)
-					flag = CHAR_FLAG;
+				if (i >= 0 && i <= 255)
+					flag = TOKEN_CHAR;
 				else if (i >= -32768 && i <= 32767)
-					flag = SHORT_FLAG;
+					flag = TOKEN_SHORT;
 				else
 				{
 					int digits = i > 0 ? (int)log10((double)i) + 1 : 1;
 					if (digits > 5)
-						flag = INT_FLAG;
+						flag = TOKEN_INT;
 				}
 			}
 			else
 			{
-				flag = FLOAT_FLAG;
+				flag = TOKEN_FLOAT;
 			}
 		}
-		if (flag == INT_FLAG)
+		if (flag == TOKEN_INT)
 		{
-			bytes = _markupStrategy->intToBytes(i);
+			FixedWidthBytes<4>::write(i, xml);
 		}
-		else if (flag == FLOAT_FLAG)
+		else if (flag == TOKEN_FLOAT)
 		{
-			bytes = floatToBytes(f);
+			size_t end = xml.size();
+			xml.resize(end + sizeof(float));
+			memcpy(&xml[end], &f, sizeof(float));
 		}
-		else if (flag == SHORT_FLAG)
+		else if (flag == TOKEN_SHORT)
 		{
-			bytes = _markupStrategy->shortToBytes(i);
+			// wartosci typu short zapisywane sa w kolejnosci little-endian
+			xml.push_back(char(i & 0xFF));
+			xml.push_back(char(i >> 8 & 0xFF));
 		}
-		else if (flag == CHAR_FLAG)
+		else if (flag == TOKEN_CHAR)
 		{
-			auto byte = _markupStrategy->intToByte(i);
-			bytes.push_back(byte);
+			FixedWidthBytes<1>::write(i, xml);
 		}
 		else
 		{
-			int size = str.size();
-			bytes = _markupStrategy->intToBytes(size);
+			FixedWidthBytes<4>::write(str.size(), xml);
 		}
-		return bytes;
+		return flag;
 	}
 
 	/// <summary>
-	/// Konwenrtuje ciag bajtow do postaci stringa.
+	/// Odczytuje wartosc zapisana jako ciag bajtow w jej pierwotnym typie.
 	/// </summary>
-	/// <param name="nextFlag">Flaga wartosci.</param>
+	/// <param name="type">Typ wartosci.</param>
 	/// <param name="bytes">Zbior bajtow.</param>
 	/// <param name="index">Indeks pierwszego bajtu.</param>
-	/// <param name="strategy">Strategia odczytywania.</param>
 	/// <param name="source">Miejsce skad odczytac wartosci stringowe.</param>
 	/// <param name="sourcePos">Pozycja z ktorej odczytac wartosc stringowa.</param>
 	/// <returns></returns>
-	std::string bytesToString(char nextFlag, std::string const & bytes, int & index, AbstractReadByteStrategy * strategy, std::string const & source, int & sourcePos)
+	XmlValue readValue(XmlValue::Type type, std::string const & bytes, int & index, std::string const & source, int & sourcePos)
 	{
-		std::string value;
-		if (nextFlag == INT_FLAG)
+		XmlValue value;
+		value.type = type;
+		value.text = source.data() + sourcePos;
+		value.length = 0;
+		checkBytes(bytes, index, type == XmlValue::Short ? 2 : type == XmlValue::Char ? 1 : 4);
+		if (type == XmlValue::Int)
 		{
-			int valueInt = strategy->bytesToInt(bytes, index);
-			value = std::to_string(valueInt);
+			value.intValue = FixedWidthBytes<4>::read(&bytes[index]);
 			index += 4;
 		}
-		else if (nextFlag == FLOAT_FLAG)
+		else if (type == XmlValue::Float)
 		{
-			float valueFloat = strategy->bytesToFloat(bytes, index);
-			value = std::to_string(valueFloat);
+			memcpy(&value.floatValue, &bytes[index], sizeof(float));
 			index += 4;
 		}
-		else if (nextFlag == SHORT_FLAG)
+		else if (type == XmlValue::Short)
 		{
-			short valueShort = strategy->bytesToShort(bytes, index);
-			value = std::to_string(valueShort);
+			value.intValue = short((unsigned char)bytes[index] | (unsigned char)bytes[index + 1] << 8);
 			index += 2;
 		}
-		else if (nextFlag == CHAR_FLAG)
+		else if (type == XmlValue::Char)
 		{
-			unsigned char charValue = bytes[index];
-			value = std::to_string(charValue);
+			value.intValue = FixedWidthBytes<1>::read(&bytes[index]);
 			index += 1;
 		}
-		else if (nextFlag == STRING_FLAG)
+		else
 		{
-			int sizeStr = strategy->bytesToInt(bytes, index);
-			value = source.substr(sourcePos, sizeStr);
+			int sizeStr = FixedWidthBytes<4>::read(&bytes[index]);
+			if (sizeStr < 0 || sizeStr > (int)source.size() - sourcePos)
+				throw std::runtime_error("Niepoprawna dlugosc wartosci");
+			value.length = sizeStr;
 			index += 4;
 			sourcePos += sizeStr;
 		}
@@ -485,134 +1241,321 @@ private:
 	}
 
 	/// <summary>
-	/// Zapisuje zawartosc pliku XML jako binarna forme znacznikow i ich wartosci
+	/// Sprawdza, czy w strukturze zostalo co najmniej count bajtow od podanego indeksu.
 	/// </summary>
-	/// <param name="firstNode">Pierwszy wezel xml.</param>
+	static void checkBytes(std::string const & bytes, int index, int count)
+	{
+		if (index < 0 || count > (int)bytes.size() - index)
+			throw std::runtime_error("Niepoprawna struktura pliku");
+	}
+
+	/// <summary>
+	/// Odczytuje identyfikator nazwy ze struktury.
+	/// </summary>
+	template <class Bytes>
+	static int readId(std::string const & bytes, int & index)
+	{
+		checkBytes(bytes, index, Bytes::SIZE);
+		int id = Bytes::read(&bytes[index]);
+		index += Bytes::SIZE;
+		return id;
+	}
+
+	/// <summary>
+	/// Zwraca nazwe o podanym identyfikatorze; identyfikator spoza mapy oznacza uszkodzony plik.
+	/// </summary>
+	static std::string const & outputName(OutputHashMap const & map, int id)
+	{
+		auto it = map.find(id);
+		if (it == map.end())
+			throw std::runtime_error("Niepoprawny identyfikator nazwy " + std::to_string(id));
+		return it->second;
+	}
+
+	/// <summary>
+	/// Zdejmuje identyfikator ostatniego otwartego wezla; zamkniecie bez otwartego wezla oznacza uszkodzony plik.
+	/// </summary>
+	static int popOpenedNode(std::stack<int> & openedNodes)
+	{
+		if (openedNodes.empty())
+			throw std::runtime_error("Niepoprawna struktura pliku");
+		int id = openedNodes.top();
+		openedNodes.pop();
+		return id;
+	}
+
+	/// <summary>
+	/// Zamienia symbol wartosci na jej typ.
+	/// </summary>
+	static XmlValue::Type tokenToValueType(StructureToken token)
+	{
+		if (token < TOKEN_STRING || token > TOKEN_FLOAT)
+			throw std::runtime_error("Niepoprawna struktura pliku");
+		return XmlValue::Type(token - TOKEN_STRING);
+	}
+
+	/// <summary>
+	/// Zamienia flage wartosci z plikow w wersji 0 na typ wartosci.
+	/// </summary>
+	/// <param name="flag">Flaga wartosci.</param>
+	XmlValue::Type flagToValueType(char flag)
+	{
+		switch (flag)
+		{
+		case CHAR_FLAG:
+			return XmlValue::Char;
+		case SHORT_FLAG:
+			return XmlValue::Short;
+		case INT_FLAG:
+			return XmlValue::Int;
+		case FLOAT_FLAG:
+			return XmlValue::Float;
+		default:
+			return XmlValue::String;
+		}
+	}
+
+	/// <summary>
+	/// Zapisuje nazwe wezla oraz jego atrybuty w binarnej formie.
+	/// </summary>
+	/// <param name="node">Wezel xml.</param>
+	/// <param name="tokens">Symbole struktury.</param>
+	/// <param name="xml">The XML.</param>
+	/// <param name="attributeValues">Miejsce zapisu wszystkich wartosci atrybutow.</param>
+	/// <returns>Identyfikator znacznika</returns>
+	template <class MarkupBytes, class AttributeBytes>
+	int saveMarkup(xml_node<>* node, std::vector<int> & tokens, std::vector<char> & xml, std::string & attributeValues)
+	{
+		// zapis nazwy znacznika
+		int nodeId = 0;
+		std::string nodeName = node->name();
+		if (!nodeName.empty())
+		{
+			nodeId = _inputMarkupNameMap.at(nodeName);
+			MarkupBytes::write(nodeId, xml);
+		}
+		tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_OPEN, nodeId));
+		// zapis atrybutow wezla
+		for (xml_attribute<>* atr = node->first_attribute(); atr; atr = atr->next_attribute())
+		{
+			// nazwa atrybutu
+			std::string attrName = atr->name();
+			int attrId = _inputAttributeNameMap.at(attrName);
+			AttributeBytes::write(attrId, xml);
+			tokens.push_back(StructureTokenCoder::attributeSymbol(TOKEN_ATTRIBUTE, attrId));
+			// wartosc atrybutu
+			std::string attrValue = atr->value();
+			StructureToken type = saveValue(attrValue, xml);
+			tokens.push_back(StructureTokenCoder::attributeSymbol(type, attrId));
+			if (type == TOKEN_STRING)
+				attributeValues += attrValue;
+		}
+		return nodeId;
+	}
+
+	/// <summary>
+	/// Zapisuje plik podzielony na fragmenty: korzen w biezacym watku, a kazdy fragment
+	/// w osobnym watku do wlasnych buforow, ktore nastepnie sa laczone w kolejnosci dokumentu.
+	/// </summary>
+	/// <param name="root">Korzen sparsowany ze znacznika otwierajacego.</param>
+	/// <param name="tokens">Symbole struktury.</param>
 	/// <param name="xml">The XML.</param>
 	/// <param name="markupValues">Miejsce zapisu wszystkich wartosci znacznikow.</param>
 	/// <param name="attributeValues">Miejsce zapisu wszystkich wartosci atrybutow.</param>
-	void saveXml(xml_node<>* firstNode, std::vector<char> & xml, std::string & markupValues, std::string & attributeValues)
+	template <class MarkupBytes, class AttributeBytes>
+	void saveShardedXml(xml_node<>* root, std::vector<int> & tokens, std::vector<char> & xml, std::string & markupValues, std::string & attributeValues)
 	{
-		for (xml_node<>* node = firstNode; node; node = node->next_sibling())
+		int rootId = saveMarkup<MarkupBytes, AttributeBytes>(root, tokens, xml, attributeValues);
+		tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_CHILDREN, rootId));
+		std::vector<std::thread> workers;
+		for (auto const & shard : _shards)
 		{
-			// zapis nazwy znacznika
-			std::string nodeName = node->name();
-			if (!nodeName.empty())
-			{
-				int nodeId = _inputMarkupNameMap[nodeName];
-				std::vector<char> bytes = _markupStrategy->writeToBytes(nodeId);
-				//xml.push_back(NEXT_NEW_NODE_SIGN);
-				xml.insert(xml.end(), bytes.begin(), bytes.end());
-			}
-			// zapis atrybutow wezla
-			for (xml_attribute<>* atr = node->first_attribute(); atr; atr = atr->next_attribute())
+			XmlShard * current = shard.get();
+			workers.emplace_back([this, current]()
 			{
-				xml.push_back(ATTRIBUTE_SIGN);
-				// nazwa atrybutu
-				std::string attrName = atr->name();
-				int attrId = _inputAttributeNameMap[attrName];
-				std::vector<char> bytes = _attributeStrategy->writeToBytes(attrId);
-				xml.insert(xml.end(), bytes.begin(), bytes.end());
-				// wartosc atrybutu
-				std::string attrValue = atr->value();
-				char typeFlag;
-				bytes = stringToValues(attrValue, typeFlag);
-				if (typeFlag == STRING_FLAG)
-					attributeValues += attrValue;
-				xml.push_back(typeFlag);
-				xml.insert(xml.end(), bytes.begin(), bytes.end());
-			}
+				saveXml<MarkupBytes, AttributeBytes>(current->doc.first_node(), current->tokens, current->xml, current->markupValues, current->attributeValues);
+			});
+		}
+		for (auto & worker : workers)
+			worker.join();
+		for (auto const & shard : _shards)
+		{
+			tokens.insert(tokens.end(), shard->tokens.begin(), shard->tokens.end());
+			xml.insert(xml.end(), shard->xml.begin(), shard->xml.end());
+			markupValues += shard->markupValues;
+			attributeValues += shard->attributeValues;
+		}
+		tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_CLOSE, rootId));
+	}
+
+	/// <summary>
+	/// Zapisuje zawartosc pliku XML jako ciag symboli struktury oraz binarna forme identyfikatorow i wartosci.
+	/// Zagniezdzenie obslugiwane jest jawnym stosem otwartych wezlow zamiast rekurencji.
+	/// </summary>
+	/// <param name="firstNode">Pierwszy wezel xml.</param>
+	/// <param name="tokens">Symbole struktury.</param>
+	/// <param name="xml">The XML.</param>
+	/// <param name="markupValues">Miejsce zapisu wszystkich wartosci znacznikow.</param>
+	/// <param name="attributeValues">Miejsce zapisu wszystkich wartosci atrybutow.</param>
+	template <class MarkupBytes, class AttributeBytes>
+	void saveXml(xml_node<>* firstNode, std::vector<int> & tokens, std::vector<char> & xml, std::string & markupValues, std::string & attributeValues)
+	{
+		std::stack<std::pair<xml_node<>*, int>> openedNodes;
+		xml_node<>* node = firstNode;
+		while (node)
+		{
+			int nodeId = saveMarkup<MarkupBytes, AttributeBytes>(node, tokens, xml, attributeValues);
 			// zapis wartosci wezla
 			const std::string value = node->value();
 			bool hasValue = !value.empty() && value.size() != 0;
 			if (hasValue)
 			{
-				//xml.push_back(NEXT_VALUE_SIGN);
-				char typeFlag;
-				std::vector<char> bytes = stringToValues(value, typeFlag);
-				if (typeFlag == STRING_FLAG)
+				StructureToken type = saveValue(value, xml);
+				tokens.push_back(StructureTokenCoder::markupSymbol(type, nodeId));
+				if (type == TOKEN_STRING)
 					markupValues += value;
-				xml.push_back(typeFlag);
-				xml.insert(xml.end(), bytes.begin(), bytes.end());
 			}
 			else
 			{
-				// zapis dzieci wezla
+				// zejscie do dzieci wezla, znak konca zapisany zostanie po ich przetworzeniu
 				auto firstChild = node->first_node();
 				bool hasChildren = firstChild != NULL && strlen(firstChild->name()) != 0;
 				if (hasChildren)
 				{
-					xml.push_back(CHILDREN_SIGN);
-					saveXml(firstChild, xml, markupValues, attributeValues);
+					tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_CHILDREN, nodeId));
+					openedNodes.push(std::make_pair(node, nodeId));
+					node = firstChild;
+					continue;
 				}
 				// zapis znaku konca wezla
-				xml.push_back(NODE_END_SIGN);
+				tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_CLOSE, nodeId));
+			}
+			// przejscie do rodzenstwa, zamykajac kolejne poziomy zagniezdzenia
+			node = node->next_sibling();
+			while (!node && !openedNodes.empty())
+			{
+				tokens.push_back(StructureTokenCoder::markupSymbol(TOKEN_CLOSE, openedNodes.top().second));
+				node = openedNodes.top().first->next_sibling();
+				openedNodes.pop();
 			}
 		}
 	}
 
 	/// <summary>
-	/// Funkcja rekurencyjnie wczytujaca plik XML. W pojedynczej iteracji wczytywana jest pojdyncza linia XML,
-	/// w pojedynczej rekurencji wylacznie wezly o jednakowym zagniezdzeniu.
+	/// Iteracyjnie wczytuje plik XML, przekazujac kolejne wezly, atrybuty i wartosci do odbiorcy zdarzen.
+	/// Przebieg wyznaczaja symbole struktury, a poziom zagniezdzenia stos identyfikatorow otwartych wezlow.
+	/// </summary>
+	/// <param name="tokens">Symbole struktury.</param>
+	/// <param name="bytes">Identyfikatory i bajty wartosci.</param>
+	/// <param name="handler">Odbiorca zdarzen.</param>
+	/// <param name="markupValueSource">Zrodlo wartosci wszystkich znacznikow.</param>
+	/// <param name="attributeValueSource">Zrodlo wartosci wszystkich atrybutow.</param>
+	template <class MarkupBytes, class AttributeBytes, class Handler>
+	void readXml(StructureTokenCoder & tokens, std::string const & bytes, Handler & handler, std::string const & markupValueSource, std::string const & attributeValueSource)
+	{
+		int id;
+		int index = 0, markupValueSourcePos = 0, attributeValueSourcePos = 0;
+		std::stack<int> lastOpenedNodes;
+		do
+		{
+			// zamkniecie otwartego wezla
+			if (tokens.decode() == TOKEN_CLOSE)
+			{
+				id = popOpenedNode(lastOpenedNodes);
+				tokens.setMarkup(id);
+				handler.endElement(id, outputName(_outputMarkupNameMap, id));
+				continue;
+			}
+			id = readId<MarkupBytes>(bytes, index);
+			tokens.setMarkup(id);
+			std::string const & nodeName = outputName(_outputMarkupNameMap, id);
+			handler.startElement(id, nodeName);
+			StructureToken next;
+			while ((next = tokens.decode()) == TOKEN_ATTRIBUTE)
+			{
+				int attrId = readId<AttributeBytes>(bytes, index);
+				std::string const & attrName = outputName(_outputAttributeNameMap, attrId);
+				tokens.setAttribute(attrId);
+				XmlValue::Type type = tokenToValueType(tokens.decode());
+				tokens.setAttribute(attrId);
+				XmlValue attrValue = readValue(type, bytes, index, attributeValueSource, attributeValueSourcePos);
+				handler.attribute(attrId, attrName, attrValue);
+			}
+			tokens.setMarkup(id);
+			if (next == TOKEN_CLOSE)
+			{
+				handler.endElement(id, nodeName);
+			}
+			else if (next == TOKEN_CHILDREN)
+			{
+				lastOpenedNodes.push(id);
+			}
+			else
+			{
+				XmlValue nodeValue = readValue(tokenToValueType(next), bytes, index, markupValueSource, markupValueSourcePos);
+				handler.text(nodeValue);
+				handler.endElement(id, nodeName);
+			}
+		} while (!lastOpenedNodes.empty());
+	}
+
+	/// <summary>
+	/// Wczytuje strukture pliku w wersji 0, w ktorej flagi zapisane sa jako bajty pomiedzy identyfikatorami.
+	/// Poziom zagniezdzenia wyznacza stos identyfikatorow otwartych wezlow.
 	/// </summary>
 	/// <param name="bytes">The bytes.</param>
-	/// <param name="xml">The XML.</param>
-	/// <param name="index">The index.</param>
+	/// <param name="handler">Odbiorca zdarzen.</param>
 	/// <param name="markupValueSource">Zrodlo wartosci wszystkich znacznikow.</param>
 	/// <param name="attributeValueSource">Zrodlo wartosci wszystkich atrybutow.</param>
-	/// <param name="tabulators">Poziom tabulacji.</param>
-	void readXml(std::string const & bytes, std::string & xml, int & index, std::string const & markupValueSource, std::string const & attributeValueSource,
-		int & markupValueSourcePos, int & attributeValueSourcePos, std::stack<std::string> & lastOpenedNodes, int tabulators)
+	template <class MarkupBytes, class AttributeBytes, class Handler>
+	void readLegacyXml(std::string const & bytes, Handler & handler, std::string const & markupValueSource, std::string const & attributeValueSource)
 	{
-		int id, markupSize = _markupStrategy->getSize(), attributeSize = _attributeStrategy->getSize();
+		int id;
+		int index = 0, markupValueSourcePos = 0, attributeValueSourcePos = 0;
+		std::stack<int> lastOpenedNodes;
 		do
 		{
-			// poczatek linii
+			checkBytes(bytes, index, 1);
 			char nextFlag = bytes[index];
 			// flaga zamkniecia otwartego wezla
 			if (nextFlag == NODE_END_SIGN)
 			{
 				++index;
-				std::string name = lastOpenedNodes.top();
-				lastOpenedNodes.pop();
-				for (int i = 0; i < tabulators - 1; ++i)
-					xml += '\t';
-				xml += "</" + name + ">\n";
-				break;
+				id = popOpenedNode(lastOpenedNodes);
+				handler.endElement(id, outputName(_outputMarkupNameMap, id));
+				continue;
 			}
-			id = _markupStrategy->read(bytes, index);
-			index += markupSize;
-			std::string nodeName = _outputMarkupNameMap[id];
-			for (int i = 0; i < tabulators; ++i)
-				xml += '\t';
-			xml += '<' + nodeName;
+			id = readId<MarkupBytes>(bytes, index);
+			std::string const & nodeName = outputName(_outputMarkupNameMap, id);
+			handler.startElement(id, nodeName);
+			checkBytes(bytes, index, 1);
 			nextFlag = bytes[index];
 			while (nextFlag == ATTRIBUTE_SIGN)
 			{
 				++index;
-				id = _attributeStrategy->read(bytes, index);
-				index += attributeSize;
-				std::string attrName = _outputAttributeNameMap[id];
+				int attrId = readId<AttributeBytes>(bytes, index);
+				std::string const & attrName = outputName(_outputAttributeNameMap, attrId);
+				checkBytes(bytes, index, 1);
 				nextFlag = bytes[index]; ++index;
-				std::string attrValue = bytesToString(nextFlag, bytes, index, _attributeStrategy, attributeValueSource, attributeValueSourcePos);
-				xml += ' ' + attrName + "=\"" + attrValue + "\"";
-				nextFlag = _attributeStrategy->read(bytes, index);
+				XmlValue attrValue = readValue(flagToValueType(nextFlag), bytes, index, attributeValueSource, attributeValueSourcePos);
+				handler.attribute(attrId, attrName, attrValue);
+				checkBytes(bytes, index, 1);
+				nextFlag = bytes[index];
 			}
 			++index;
 			if (nextFlag == NODE_END_SIGN)
 			{
-				xml += "/>\n";
+				handler.endElement(id, nodeName);
 			}
 			else if (isFlagValueType(nextFlag))
 			{
-				auto nodeValue = bytesToString(nextFlag, bytes, index, _markupStrategy, markupValueSource, markupValueSourcePos);
-				xml += '>' + nodeValue + "</" + nodeName + ">\n";
+				XmlValue nodeValue = readValue(flagToValueType(nextFlag), bytes, index, markupValueSource, markupValueSourcePos);
+				handler.text(nodeValue);
+				handler.endElement(id, nodeName);
 			}
 			else if (nextFlag == CHILDREN_SIGN)
 			{
-				xml += ">\n";
-				lastOpenedNodes.push(nodeName);
-				readXml(bytes, xml, index, markupValueSource, attributeValueSource, markupValueSourcePos, attributeValueSourcePos, lastOpenedNodes, tabulators + 1);
+				lastOpenedNodes.push(id);
 			}
 		} while (!lastOpenedNodes.empty());
 	}
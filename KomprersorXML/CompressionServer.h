@@ -0,0 +1,416 @@
+#pragma once
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CompresorXml.h"
+#include "LzDictionary.h"
+#include "PriorSet.h"
+
+/// <summary>
+/// Serwer kompresji nasluchujacy na gniezdzie domeny Unix. Polaczenia obslugiwane sa przez stala pule
+/// watkow; kazdy watek ma wlasny obiekt CompresorXml, ktorego modele, slowniki i bufory pozostaja
+/// zaalokowane miedzy zadaniami. Zadanie sklada sie z bajtu polecenia ('c' - kompresja, 'd' - dekompresja),
+/// dlugosci danych zapisanej na 4 bajtach w kolejnosci sieciowej oraz danych. Odpowiedz zawiera bajt statusu
+/// (0 - powodzenie, 1 - blad), dlugosc w tym samym formacie oraz wynik albo komunikat bledu.
+/// Jedno polaczenie moze przesylac kolejne zadania az do jego zamkniecia przez klienta; polaczenie
+/// bezczynne dluzej niz IDLE_TIMEOUT_MS zostaje zamkniete, aby nie zajmowalo watku puli.
+/// </summary>
+class CompressionServer
+{
+public:
+	enum Command : char
+	{
+		ENCODE = 'c', DECODE = 'd'
+	};
+
+	enum Status : char
+	{
+		OK = 0, FAILED = 1
+	};
+
+private:
+#ifdef _WIN32
+	typedef SOCKET Socket;
+
+	/// adres gniazda domeny Unix z afunix.h, niedostepnego w starszych wersjach Windows SDK
+	struct sockaddr_un
+	{
+		ADDRESS_FAMILY sun_family;
+		char sun_path[108];
+	};
+#else
+	typedef int Socket;
+	static const int INVALID_SOCKET = -1;
+#endif
+
+	/// <summary>
+	/// Dlugosc naglowka zadania i odpowiedzi: bajt polecenia lub statusu oraz dlugosc danych
+	/// </summary>
+	static const size_t HEADER_SIZE = 5;
+
+	/// <summary>
+	/// Najwiekszy przyjmowany rozmiar danych zadania
+	/// </summary>
+	static const uint32_t MAX_MESSAGE_SIZE = 1u << 30;
+
+	/// <summary>
+	/// Czas oczekiwania na dane polaczenia w milisekundach, po ktorym polaczenie zostaje zamkniete
+	/// </summary>
+	static const int IDLE_TIMEOUT_MS = 5000;
+
+	/// <summary>
+	/// Przerwa przed ponownym przyjeciem polaczenia po przejsciowym bledzie gniazda nasluchujacego
+	/// </summary>
+	static const int ACCEPT_RETRY_MS = 10;
+
+	std::string _path;
+	Socket _listener;
+
+	/// <summary>
+	/// Zestaw poczatkowych czestosci modeli wspolny dla wszystkich watkow
+	/// </summary>
+	std::shared_ptr<PriorSet const> _priorSet;
+
+	/// <summary>
+	/// Slowniki sekcji LZSS wspolne dla wszystkich watkow
+	/// </summary>
+	std::shared_ptr<LzDictionary const> _dictionary;
+
+	/// <summary>
+	/// Koder entropijny sekcji LZSS kompresowanych dokumentow
+	/// </summary>
+	LzssCoder::Backend _backend;
+
+	/// <summary>
+	/// Czy parametry modeli qsmodel wybierane sa dla kazdej sekcji LZSS
+	/// </summary>
+	bool _parameterSearch;
+
+	/// <summary>
+	/// Zaakceptowane polaczenia oczekujace na wolny watek
+	/// </summary>
+	std::deque<Socket> _connections;
+	std::mutex _mutex;
+	std::condition_variable _connectionReady;
+	bool _stopping;
+
+	std::vector<std::thread> _workers;
+
+public:
+	/// <summary>
+	/// Inicjalizuje obiekt klasy <see cref="CompressionServer"/>.
+	/// </summary>
+	/// <param name="path">Sciezka gniazda; istniejacy plik gniazda zostaje usuniety.</param>
+	/// <param name="priorSet">Zestaw poczatkowych czestosci modeli albo nullptr.</param>
+	/// <param name="dictionary">Slowniki sekcji LZSS albo nullptr.</param>
+	/// <param name="backend">Koder entropijny sekcji LZSS.</param>
+	/// <param name="parameterSearch">Czy wybierac parametry modeli qsmodel kazdej sekcji.</param>
+	explicit CompressionServer(std::string const & path, std::shared_ptr<PriorSet const> priorSet = nullptr,
+		std::shared_ptr<LzDictionary const> dictionary = nullptr, LzssCoder::Backend backend = LzssCoder::RANGE_CODER,
+		bool parameterSearch = false)
+		: _path(path), _listener(INVALID_SOCKET), _priorSet(priorSet), _dictionary(dictionary), _backend(backend),
+		_parameterSearch(parameterSearch), _stopping(false)
+	{
+	}
+
+	~CompressionServer()
+	{
+		stop();
+	}
+
+	/// <summary>
+	/// Uruchamia pule watkow i przyjmuje polaczenia do czasu bledu gniazda nasluchujacego.
+	/// </summary>
+	/// <param name="threadCount">Liczba watkow; 0 oznacza liczbe rdzeni.</param>
+	void run(size_t threadCount = 0)
+	{
+		listen();
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < threadCount; ++i)
+			_workers.emplace_back([this]() { work(); });
+
+		while (true)
+		{
+			Socket connection = accept(_listener, nullptr, nullptr);
+			if (connection == INVALID_SOCKET)
+			{
+				if (transientAcceptError())
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(int(ACCEPT_RETRY_MS)));
+					continue;
+				}
+				stop();
+				throw std::runtime_error("Nie mozna przyjac polaczenia na gniezdzie " + _path);
+			}
+			setIdleTimeout(connection);
+			std::lock_guard<std::mutex> lock(_mutex);
+			_connections.push_back(connection);
+			_connectionReady.notify_one();
+		}
+	}
+
+private:
+	void listen()
+	{
+#ifdef _WIN32
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+			throw std::runtime_error("Nie mozna zainicjalizowac biblioteki Winsock");
+#endif
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (_path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("Za dluga sciezka gniazda " + _path);
+		memcpy(address.sun_path, _path.c_str(), _path.size());
+		remove(_path.c_str());
+
+		_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (_listener == INVALID_SOCKET
+			|| bind(_listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+			|| ::listen(_listener, SOMAXCONN) != 0)
+		{
+			stop();
+			throw std::runtime_error("Nie mozna nasluchiwac na gniezdzie " + _path);
+		}
+	}
+
+	/// <summary>
+	/// Sprawdza, czy blad accept dotyczyl tylko jednego polaczenia lub chwilowego braku zasobow.
+	/// </summary>
+	static bool transientAcceptError()
+	{
+#ifdef _WIN32
+		int error = WSAGetLastError();
+		return error == WSAEINTR || error == WSAECONNRESET || error == WSAEMFILE || error == WSAENOBUFS;
+#else
+		int error = errno;
+		return error == EINTR || error == ECONNABORTED || error == EPROTO || error == EMFILE
+			|| error == ENFILE || error == ENOBUFS || error == ENOMEM;
+#endif
+	}
+
+	/// <summary>
+	/// Ustawia limit czasu odbioru, po ktorym bezczynne polaczenie zwalnia watek puli.
+	/// </summary>
+	static void setIdleTimeout(Socket connection)
+	{
+#ifdef _WIN32
+		DWORD timeout = IDLE_TIMEOUT_MS;
+#else
+		timeval timeout;
+		timeout.tv_sec = IDLE_TIMEOUT_MS / 1000;
+		timeout.tv_usec = (IDLE_TIMEOUT_MS % 1000) * 1000;
+#endif
+		setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const *>(&timeout), sizeof(timeout));
+	}
+
+	/// <summary>
+	/// Zamyka gniazdo nasluchujace i oczekujace polaczenia oraz czeka na zakonczenie watkow.
+	/// </summary>
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+			for (Socket connection : _connections)
+				closeSocket(connection);
+			_connections.clear();
+		}
+		_connectionReady.notify_all();
+		for (auto & worker : _workers)
+			worker.join();
+		_workers.clear();
+		if (_listener != INVALID_SOCKET)
+		{
+			closeSocket(_listener);
+			_listener = INVALID_SOCKET;
+			remove(_path.c_str());
+		}
+	}
+
+	/// <summary>
+	/// Petla watku puli: przygotowuje kompresor, a nastepnie obsluguje kolejne polaczenia.
+	/// </summary>
+	void work()
+	{
+		std::unique_ptr<CompresorXml> compressor(new CompresorXml());
+		compressor->setPriorSet(_priorSet);
+		compressor->setDictionary(_dictionary);
+		compressor->setBackend(_backend);
+		compressor->setParameterSearch(_parameterSearch);
+		warmUp(*compressor);
+		while (true)
+		{
+			Socket connection;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_connectionReady.wait(lock, [this]() { return _stopping || !_connections.empty(); });
+				if (_stopping)
+					return;
+				connection = _connections.front();
+				_connections.pop_front();
+			}
+			serve(*compressor, connection);
+			closeSocket(connection);
+		}
+	}
+
+	/// <summary>
+	/// Kompresuje i dekompresuje maly dokument, aby modele obu kierunkow byly zaalokowane
+	/// przed pierwszym zadaniem.
+	/// </summary>
+	void warmUp(CompresorXml & compressor)
+	{
+		static char const document[] = "<a b=\"c\" d=\"1\"><e>f</e><g>2</g><h>300</h><i>70000</i><j>0.5</j></a>";
+		std::vector<char> xml(document, document + sizeof(document) - 1);
+		std::vector<char> archive;
+		std::string decoded;
+		compressor.encode(xml, archive);
+		compressor.decode(archive, decoded);
+	}
+
+	/// <summary>
+	/// Obsluguje kolejne zadania jednego polaczenia do jego zamkniecia, bledu transmisji lub uplywu limitu bezczynnosci.
+	/// </summary>
+	void serve(CompresorXml & compressor, Socket connection)
+	{
+		std::vector<char> request;
+		std::vector<char> archive;
+		std::string xml;
+		char header[HEADER_SIZE];
+		while (receive(connection, header, HEADER_SIZE))
+		{
+			uint32_t length = readLength(header + 1);
+			if (length > MAX_MESSAGE_SIZE)
+			{
+				reply(connection, FAILED, "Za duze zadanie");
+				return;
+			}
+			request.resize(length);
+			if (!receive(connection, request.data(), length))
+				return;
+
+			bool sent;
+			try
+			{
+				switch (header[0])
+				{
+				case ENCODE:
+					compressor.encode(request, archive);
+					sent = reply(connection, OK, archive.data(), archive.size());
+					break;
+				case DECODE:
+					compressor.decode(request, xml);
+					sent = reply(connection, OK, xml.data(), xml.size());
+					break;
+				default:
+					sent = reply(connection, FAILED, "Nieznane polecenie");
+					break;
+				}
+			}
+			catch (std::exception const & ex)
+			{
+				sent = reply(connection, FAILED, ex.what());
+			}
+			if (!sent)
+				return;
+		}
+	}
+
+	bool reply(Socket connection, Status status, std::string const & message)
+	{
+		return reply(connection, status, message.data(), message.size());
+	}
+
+	bool reply(Socket connection, Status status, char const * data, size_t length)
+	{
+		char header[HEADER_SIZE];
+		header[0] = status;
+		writeLength(static_cast<uint32_t>(length), header + 1);
+		return transmit(connection, header, HEADER_SIZE) && transmit(connection, data, length);
+	}
+
+	static uint32_t readLength(char const * bytes)
+	{
+		unsigned char const * b = reinterpret_cast<unsigned char const *>(bytes);
+		return uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 | b[3];
+	}
+
+	static void writeLength(uint32_t length, char * bytes)
+	{
+		for (int i = 3; i >= 0; --i, length >>= 8)
+			bytes[i] = static_cast<char>(length & 0xFF);
+	}
+
+	/// <summary>
+	/// Odbiera dokladnie podana liczbe bajtow.
+	/// </summary>
+	/// <returns><c>false</c> jezeli polaczenie zostalo zamkniete, zerwane lub uplynal limit bezczynnosci</returns>
+	static bool receive(Socket connection, char * data, size_t length)
+	{
+		while (length > 0)
+		{
+			int chunk = static_cast<int>(std::min<size_t>(length, INT_MAX));
+			int received = recv(connection, data, chunk, 0);
+			if (received <= 0)
+				return false;
+			data += received;
+			length -= received;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Wysyla wszystkie bajty; zerwane polaczenie nie przerywa procesu sygnalem.
+	/// </summary>
+	static bool transmit(Socket connection, char const * data, size_t length)
+	{
+#ifdef MSG_NOSIGNAL
+		const int flags = MSG_NOSIGNAL;
+#else
+		const int flags = 0;
+#endif
+		while (length > 0)
+		{
+			int chunk = static_cast<int>(std::min<size_t>(length, INT_MAX));
+			int sent = send(connection, data, chunk, flags);
+			if (sent <= 0)
+				return false;
+			data += sent;
+			length -= sent;
+		}
+		return true;
+	}
+
+	static void closeSocket(Socket socket)
+	{
+#ifdef _WIN32
+		closesocket(socket);
+#else
+		close(socket);
+#endif
+	}
+};
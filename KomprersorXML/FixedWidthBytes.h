@@ -0,0 +1,123 @@
+#pragma once
+#include <vector>
+#include "ReadStrategyEnum.h"
+
+/// <summary>
+/// Zapis i odczyt liczby calkowitej o szerokosci znanej w czasie kompilacji. Zastepuje wirtualne
+/// strategie odczytu: szerokosc identyfikatorow wybierana jest raz na plik, a petle kodowania
+/// i dekodowania sa dla niej konkretyzowane.
+/// </summary>
+template <int Size>
+struct FixedWidthBytes;
+
+/// <summary>
+/// Jeden bajt bez znaku
+/// </summary>
+template <>
+struct FixedWidthBytes<1>
+{
+	static const int SIZE = 1;
+
+	static int read(char const * bytes)
+	{
+		return (unsigned char)bytes[0];
+	}
+
+	static void write(int value, std::vector<char> & out)
+	{
+		out.push_back(char(value));
+	}
+};
+
+/// <summary>
+/// Dwa bajty w kolejnosci big-endian. Pierwszy bajt identyfikatora jest zawsze nieujemny,
+/// wiec nie myli sie z flagami struktury.
+/// </summary>
+template <>
+struct FixedWidthBytes<2>
+{
+	static const int SIZE = 2;
+
+	static int read(char const * bytes)
+	{
+		return short((unsigned char)bytes[0] << 8 | (unsigned char)bytes[1]);
+	}
+
+	static void write(int value, std::vector<char> & out)
+	{
+		size_t end = out.size();
+		out.resize(end + SIZE);
+		out[end] = char(value >> 8 & 0xFF);
+		out[end + 1] = char(value & 0xFF);
+	}
+};
+
+/// <summary>
+/// Cztery bajty w kolejnosci big-endian
+/// </summary>
+template <>
+struct FixedWidthBytes<4>
+{
+	static const int SIZE = 4;
+
+	static int read(char const * bytes)
+	{
+		return int(
+			(unsigned char)bytes[0] << 24 |
+			(unsigned char)bytes[1] << 16 |
+			(unsigned char)bytes[2] << 8 |
+			(unsigned char)bytes[3] << 0);
+	}
+
+	static void write(int value, std::vector<char> & out)
+	{
+		size_t end = out.size();
+		out.resize(end + SIZE);
+		for (int i = 0; i < SIZE; ++i)
+			out[end + 3 - i] = char(value >> (i * 8) & 0xFF);
+	}
+};
+
+/// <summary>
+/// Druga czesc wyboru szerokosci w dispatchWidths, dla ustalonej szerokosci identyfikatorow znacznikow.
+/// </summary>
+template <class MarkupBytes, class Function>
+void dispatchAttributeWidth(ReadStrategy attributeWidth, Function & function)
+{
+	switch (attributeWidth)
+	{
+	case ReadStrategy::Char:
+		function(MarkupBytes(), FixedWidthBytes<1>());
+		break;
+	case ReadStrategy::Short:
+		function(MarkupBytes(), FixedWidthBytes<2>());
+		break;
+	case ReadStrategy::Int:
+		function(MarkupBytes(), FixedWidthBytes<4>());
+		break;
+	}
+}
+
+/// <summary>
+/// Wywoluje funkcje z obiektami FixedWidthBytes odpowiadajacymi szerokosciom identyfikatorow
+/// znacznikow i atrybutow zapisanym w naglowku pliku.
+/// </summary>
+/// <param name="markupWidth">Szerokosc identyfikatorow znacznikow.</param>
+/// <param name="attributeWidth">Szerokosc identyfikatorow atrybutow.</param>
+/// <param name="function">Funkcja wywolywana jako function(FixedWidthBytes&lt;M&gt;(), FixedWidthBytes&lt;A&gt;()).</param>
+template <class Function>
+void dispatchWidths(ReadStrategy markupWidth, ReadStrategy attributeWidth, Function function)
+{
+	switch (markupWidth)
+	{
+	case ReadStrategy::Char:
+		dispatchAttributeWidth<FixedWidthBytes<1>>(attributeWidth, function);
+		break;
+	case ReadStrategy::Short:
+		dispatchAttributeWidth<FixedWidthBytes<2>>(attributeWidth, function);
+		break;
+	case ReadStrategy::Int:
+		dispatchAttributeWidth<FixedWidthBytes<4>>(attributeWidth, function);
+		break;
+	}
+}
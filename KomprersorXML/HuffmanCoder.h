@@ -0,0 +1,347 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+#include "RansCoder.h"
+
+/// <summary>
+/// Statyczne kody Huffmana wyznaczane dla bloku danych. Zapisywane sa tylko dlugosci kodow, z ktorych
+/// obie strony wyznaczaja te same kody kanoniczne. Bity zapisywane sa od najmlodszego, a kody odwrocone,
+/// dzieki czemu dekoder odczytuje symbol jednym spojrzeniem do tablicy indeksowanej kolejnymi bitami.
+/// </summary>
+class HuffmanCoder
+{
+public:
+	/// <summary>
+	/// Najwieksza dlugosc kodu; tablica dekodera ma 1 &lt;&lt; MAX_CODE_LENGTH pozycji
+	/// </summary>
+	static const int MAX_CODE_LENGTH = 12;
+
+	/// <summary>
+	/// Kody symboli jednego bloku. Pozycja tablicy dekodera moze zawierac dwa symbole, jezeli oba sa
+	/// z poczatkowej czesci alfabetu (litery) i ich kody mieszcza sie razem w MAX_CODE_LENGTH bitach.
+	/// </summary>
+	class Table
+	{
+	public:
+		struct DecodeEntry
+		{
+			uint16_t first;
+			uint16_t second;
+			uint8_t firstLength;
+			uint8_t pairLength;
+		};
+
+	private:
+		std::vector<uint32_t> _counts;
+		std::vector<uint8_t> _lengths;
+		std::vector<uint16_t> _codes;
+		std::vector<DecodeEntry> _decodeTable;
+
+	public:
+		explicit Table(int alphabetSize = 0) : _counts(alphabetSize, 0), _lengths(alphabetSize, 0), _codes(alphabetSize, 0)
+		{
+		}
+
+		/// <summary>
+		/// Zeruje liczniki przed kolejnym blokiem.
+		/// </summary>
+		void clear()
+		{
+			std::fill(_counts.begin(), _counts.end(), 0);
+		}
+
+		void count(int symbol)
+		{
+			++_counts[symbol];
+		}
+
+		int length(int symbol) const
+		{
+			return _lengths[symbol];
+		}
+
+		int code(int symbol) const
+		{
+			return _codes[symbol];
+		}
+
+		/// <summary>
+		/// Wyznacza kody z licznikow i zapisuje ich dlugosci: liczbe symboli z kodem, a nastepnie pary
+		/// odstep i dlugosc albo, jezeli tak jest krocej, dlugosci wszystkich symboli po dwie w bajcie.
+		/// </summary>
+		void save(std::vector<char> & target)
+		{
+			buildLengths();
+			size_t present = _lengths.size() - std::count(_lengths.begin(), _lengths.end(), uint8_t(0));
+			RansCoder::writeNumber(target, static_cast<uint32_t>(present));
+			if (present * 4 < _lengths.size())
+			{
+				int previous = -1;
+				for (int i = 0; i < (int)_lengths.size(); ++i)
+				{
+					if (_lengths[i] > 0)
+					{
+						RansCoder::writeNumber(target, i - previous - 1);
+						target.push_back(static_cast<char>(_lengths[i]));
+						previous = i;
+					}
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < _lengths.size(); i += 2)
+					target.push_back(static_cast<char>(_lengths[i] | (i + 1 < _lengths.size() ? _lengths[i + 1] : 0) << 4));
+			}
+			buildCodes();
+		}
+
+		/// <summary>
+		/// Wczytuje dlugosci kodow zapisane przez save i buduje tablice dekodera.
+		/// </summary>
+		/// <param name="pairable">Liczba poczatkowych symboli alfabetu, ktore moga byc odczytywane parami.</param>
+		void load(std::vector<char> const & source, int & pos, int pairable)
+		{
+			size_t present = RansCoder::readNumber(source, pos);
+			std::fill(_lengths.begin(), _lengths.end(), 0);
+			if (present * 4 < _lengths.size())
+			{
+				size_t symbol = 0;
+				for (size_t i = 0; i < present; ++i, ++symbol)
+				{
+					symbol += RansCoder::readNumber(source, pos);
+					if (symbol >= _lengths.size() || pos >= (int)source.size())
+						throw std::runtime_error("Niepoprawna sekcja Huffmana");
+					_lengths[symbol] = static_cast<uint8_t>(source[pos++]);
+				}
+			}
+			else
+			{
+				size_t size = (_lengths.size() + 1) / 2;
+				if (pos + size > source.size())
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+				for (size_t i = 0; i < _lengths.size(); ++i)
+					_lengths[i] = static_cast<unsigned char>(source[pos + i / 2]) >> (i % 2 * 4) & 0xF;
+				pos += static_cast<int>(size);
+			}
+			for (uint8_t length : _lengths)
+			{
+				if (length > MAX_CODE_LENGTH)
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+			}
+			buildCodes();
+			buildDecodeTable(pairable);
+		}
+
+		/// <summary>
+		/// Pozycja tablicy dekodera dla kolejnych MAX_CODE_LENGTH bitow; firstLength rowne 0 oznacza
+		/// niepoprawny kod, a pairLength rowne 0 brak drugiego symbolu.
+		/// </summary>
+		DecodeEntry const & entry(uint32_t bits) const
+		{
+			return _decodeTable[bits];
+		}
+
+	private:
+		/// <summary>
+		/// Wyznacza dlugosci kodow Huffmana; jezeli najdluzszy kod przekracza MAX_CODE_LENGTH,
+		/// liczniki sa polowione i kody wyznaczane ponownie.
+		/// </summary>
+		void buildLengths()
+		{
+			std::vector<uint32_t> counts(_counts);
+			while (true)
+			{
+				std::fill(_lengths.begin(), _lengths.end(), 0);
+				// wezly: liscie to symbole, kolejne wezly to polaczenia; rodzic kazdego wezla w parents
+				typedef std::pair<uint64_t, int> Node;
+				std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+				std::vector<int> parents;
+				std::vector<int> leaves;
+				for (int i = 0; i < (int)counts.size(); ++i)
+				{
+					if (counts[i] > 0)
+					{
+						queue.push(Node(counts[i], static_cast<int>(parents.size())));
+						parents.push_back(-1);
+						leaves.push_back(i);
+					}
+				}
+				if (leaves.size() == 1)
+					_lengths[leaves[0]] = 1;
+				if (leaves.size() <= 1)
+					return;
+				while (queue.size() > 1)
+				{
+					Node a = queue.top();
+					queue.pop();
+					Node b = queue.top();
+					queue.pop();
+					int parent = static_cast<int>(parents.size());
+					parents.push_back(-1);
+					parents[a.second] = parent;
+					parents[b.second] = parent;
+					queue.push(Node(a.first + b.first, parent));
+				}
+				int longest = 0;
+				for (size_t leaf = 0; leaf < leaves.size(); ++leaf)
+				{
+					int depth = 0;
+					for (int node = static_cast<int>(leaf); parents[node] >= 0; node = parents[node])
+						++depth;
+					_lengths[leaves[leaf]] = static_cast<uint8_t>(depth);
+					longest = std::max(longest, depth);
+				}
+				if (longest <= MAX_CODE_LENGTH)
+					return;
+				for (uint32_t & count : counts)
+					count = (count + 1) >> 1;
+			}
+		}
+
+		/// <summary>
+		/// Przydziela kody kanoniczne wedlug dlugosci i numeru symbolu, a nastepnie odwraca ich bity.
+		/// </summary>
+		void buildCodes()
+		{
+			int lengthCounts[MAX_CODE_LENGTH + 1] = {};
+			for (uint8_t length : _lengths)
+				++lengthCounts[length];
+			lengthCounts[0] = 0;
+			int nextCode[MAX_CODE_LENGTH + 2] = {};
+			for (int length = 1; length <= MAX_CODE_LENGTH; ++length)
+				nextCode[length + 1] = (nextCode[length] + lengthCounts[length]) << 1;
+			for (size_t i = 0; i < _lengths.size(); ++i)
+			{
+				int length = _lengths[i];
+				if (length == 0)
+					continue;
+				int code = nextCode[length]++;
+				if (code >= 1 << length)
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+				int reversed = 0;
+				for (int bit = 0; bit < length; ++bit)
+					reversed |= (code >> bit & 1) << (length - 1 - bit);
+				_codes[i] = static_cast<uint16_t>(reversed);
+			}
+		}
+
+		void buildDecodeTable(int pairable)
+		{
+			const int size = 1 << MAX_CODE_LENGTH;
+			DecodeEntry empty = {};
+			_decodeTable.assign(size, empty);
+			for (size_t symbol = 0; symbol < _lengths.size(); ++symbol)
+			{
+				int length = _lengths[symbol];
+				if (length == 0)
+					continue;
+				for (int bits = _codes[symbol]; bits < size; bits += 1 << length)
+				{
+					_decodeTable[bits].first = static_cast<uint16_t>(symbol);
+					_decodeTable[bits].firstLength = static_cast<uint8_t>(length);
+				}
+			}
+			for (int bits = 0; bits < size; ++bits)
+			{
+				DecodeEntry & entry = _decodeTable[bits];
+				if (entry.firstLength == 0 || entry.first >= pairable)
+					continue;
+				DecodeEntry const & next = _decodeTable[bits >> entry.firstLength];
+				if (next.firstLength > 0 && next.first < pairable && entry.firstLength + next.firstLength <= MAX_CODE_LENGTH)
+				{
+					entry.second = next.first;
+					entry.pairLength = static_cast<uint8_t>(entry.firstLength + next.firstLength);
+				}
+			}
+		}
+	};
+
+	/// <summary>
+	/// Zapisuje bity od najmlodszego do wektora.
+	/// </summary>
+	class BitWriter
+	{
+		std::vector<char> & _target;
+		uint64_t _bits;
+		int _count;
+
+	public:
+		explicit BitWriter(std::vector<char> & target) : _target(target), _bits(0), _count(0)
+		{
+		}
+
+		void write(uint32_t value, int count)
+		{
+			_bits |= uint64_t(value) << _count;
+			_count += count;
+			while (_count >= 8)
+			{
+				_target.push_back(static_cast<char>(_bits & 0xFF));
+				_bits >>= 8;
+				_count -= 8;
+			}
+		}
+
+		/// <summary>
+		/// Zapisuje niepelny ostatni bajt.
+		/// </summary>
+		void flush()
+		{
+			if (_count > 0)
+				_target.push_back(static_cast<char>(_bits & 0xFF));
+			_bits = 0;
+			_count = 0;
+		}
+	};
+
+	/// <summary>
+	/// Odczytuje bity zapisane przez BitWriter; za koncem danych zera.
+	/// </summary>
+	class BitReader
+	{
+		unsigned char const * _input;
+		unsigned char const * _inputEnd;
+		uint64_t _bits;
+		int _count;
+
+	public:
+		BitReader(unsigned char const * input, unsigned char const * inputEnd)
+			: _input(input), _inputEnd(inputEnd), _bits(0), _count(0)
+		{
+		}
+
+		/// <summary>
+		/// Uzupelnia bufor do co najmniej 57 bitow.
+		/// </summary>
+		void refill()
+		{
+			while (_count <= 56)
+			{
+				_bits |= uint64_t(_input < _inputEnd ? *_input++ : 0) << _count;
+				_count += 8;
+			}
+		}
+
+		uint32_t peek(int count) const
+		{
+			return static_cast<uint32_t>(_bits & ((1u << count) - 1));
+		}
+
+		void skip(int count)
+		{
+			_bits >>= count;
+			_count -= count;
+		}
+
+		uint32_t read(int count)
+		{
+			uint32_t value = peek(count);
+			skip(count);
+			return value;
+		}
+	};
+};
@@ -0,0 +1,209 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Model liter kodujacy kazdy bajt jako 8 bitow od najstarszego. Prawdopodobienstwo bitu przewidywane jest
+/// przez modele rzedu 0, rzedu 1 (poprzedni bajt) i rzedu 2 (skrot dwoch poprzednich bajtow), a ich
+/// przewidywania laczone sa w dziedzinie logitu z wagami uczonymi osobno dla kazdego bitu bajtu.
+/// Prawdopodobienstwa zapisywane sa na 12 bitach, jak czestosci modeli qsmodel. Bity koduje koder
+/// przekazany do encode i decode, udostepniajacy encodePredicted i decodePredicted.
+/// </summary>
+class LiteralContextModel
+{
+public:
+	static const int PROBABILITY_BITS = 12;
+
+private:
+	static const int PROBABILITY_ONE = 1 << PROBABILITY_BITS;
+
+	/// <summary>
+	/// Szybkosc adaptacji modeli bitow: przesuniecie bledu przy aktualizacji
+	/// </summary>
+	static const int ADAPTATION_SHIFT = 4;
+
+	/// <summary>
+	/// Liczba bitow skrotu kontekstu rzedu 2 wraz z wezlem drzewa bitow bajtu
+	/// </summary>
+	static const int ORDER2_BITS = 16;
+
+	static const int INPUT_COUNT = 3;
+	static const int WEIGHT_BITS = 16;
+	static const int LEARNING_RATE = 2;
+
+	/// <summary>
+	/// Prawdopodobienstwa jedynki w wezlach drzewa bitow: bez kontekstu, dla kazdego poprzedniego bajtu
+	/// oraz dla skrotu dwoch poprzednich bajtow
+	/// </summary>
+	std::vector<uint16_t> _order0, _order1, _order2;
+
+	/// <summary>
+	/// Wagi mieszania przewidywan dla kolejnych bitow bajtu
+	/// </summary>
+	int _weights[8][INPUT_COUNT];
+
+	/// <summary>
+	/// Odwrotnosc funkcji squash dla prawdopodobienstw 12-bitowych
+	/// </summary>
+	static short const * stretchTable()
+	{
+		static std::vector<short> table = buildStretchTable();
+		return table.data();
+	}
+
+public:
+	LiteralContextModel()
+		: _order0(256), _order1(256 * 256), _order2(1 << ORDER2_BITS)
+	{
+		reset(nullptr);
+	}
+
+	/// <summary>
+	/// Przywraca poczatkowe prawdopodobienstwa przed kolejna sekcja.
+	/// </summary>
+	/// <param name="letters">Poczatkowe czestosci bajtow dla modelu rzedu 0 albo nullptr dla rozkladu rownomiernego.</param>
+	void reset(std::vector<int> const * letters)
+	{
+		std::fill(_order1.begin(), _order1.end(), uint16_t(PROBABILITY_ONE / 2));
+		std::fill(_order2.begin(), _order2.end(), uint16_t(PROBABILITY_ONE / 2));
+		for (int node = 1; node < 256; ++node)
+			_order0[node] = letters && letters->size() >= 256 ? nodeProbability(*letters, node) : PROBABILITY_ONE / 2;
+		for (auto & weights : _weights)
+			std::fill(weights, weights + INPUT_COUNT, (1 << WEIGHT_BITS) / 2);
+	}
+
+	/// <summary>
+	/// Koduje bajt w kontekscie dwoch poprzednich bajtow sekcji.
+	/// </summary>
+	template <class Coder>
+	void encode(Coder & coder, unsigned char letter, unsigned char previous, unsigned char beforePrevious)
+	{
+		int node = 1;
+		for (int i = 7; i >= 0; --i)
+		{
+			int bit = letter >> i & 1;
+			Prediction prediction = predict(node, 7 - i, previous, beforePrevious);
+			coder.encodePredicted(prediction.probability, bit);
+			update(prediction, bit);
+			node = node << 1 | bit;
+		}
+	}
+
+	/// <summary>
+	/// Dekoduje bajt w kontekscie dwoch poprzednich bajtow sekcji.
+	/// </summary>
+	template <class Coder>
+	unsigned char decode(Coder & coder, unsigned char previous, unsigned char beforePrevious)
+	{
+		int node = 1;
+		for (int i = 0; i < 8; ++i)
+		{
+			Prediction prediction = predict(node, i, previous, beforePrevious);
+			int bit = coder.decodePredicted(prediction.probability);
+			update(prediction, bit);
+			node = node << 1 | bit;
+		}
+		return static_cast<unsigned char>(node);
+	}
+
+private:
+	/// <summary>
+	/// Przewidywanie jednego bitu wraz z miejscami, ktore trzeba zaktualizowac po jego zakodowaniu
+	/// </summary>
+	struct Prediction
+	{
+		uint16_t * models[INPUT_COUNT];
+		int stretched[INPUT_COUNT];
+		int * weights;
+		int probability;
+	};
+
+	Prediction predict(int node, int bitIndex, unsigned char previous, unsigned char beforePrevious)
+	{
+		Prediction prediction;
+		prediction.models[0] = &_order0[node];
+		prediction.models[1] = &_order1[previous << 8 | node];
+		uint32_t context = (uint32_t(beforePrevious) << 8 | previous) * 0x9E3779B1u;
+		prediction.models[2] = &_order2[(context >> (32 - ORDER2_BITS) ^ node * 0x2F) & ((1 << ORDER2_BITS) - 1)];
+		prediction.weights = _weights[bitIndex];
+		short const * stretch = stretchTable();
+		long long dot = 0;
+		for (int i = 0; i < INPUT_COUNT; ++i)
+		{
+			prediction.stretched[i] = stretch[*prediction.models[i]];
+			dot += static_cast<long long>(prediction.weights[i]) * prediction.stretched[i];
+		}
+		prediction.probability = std::min(std::max(squash(static_cast<int>(dot >> WEIGHT_BITS)), 1), PROBABILITY_ONE - 1);
+		return prediction;
+	}
+
+	void update(Prediction const & prediction, int bit)
+	{
+		int error = ((bit << PROBABILITY_BITS) - prediction.probability) * LEARNING_RATE;
+		for (int i = 0; i < INPUT_COUNT; ++i)
+		{
+			prediction.weights[i] += (prediction.stretched[i] * error) >> 10;
+			uint16_t & model = *prediction.models[i];
+			if (bit)
+				model += (PROBABILITY_ONE - model) >> ADAPTATION_SHIFT;
+			else
+				model -= model >> ADAPTATION_SHIFT;
+		}
+	}
+
+	/// <summary>
+	/// Prawdopodobienstwo jedynki w wezle drzewa bitow wyznaczone z czestosci bajtow.
+	/// </summary>
+	static uint16_t nodeProbability(std::vector<int> const & letters, int node)
+	{
+		int depth = 0;
+		while (node >> (depth + 1))
+			++depth;
+		int width = 1 << (8 - depth);
+		int first = (node - (1 << depth)) * width;
+		long long zeros = 0, ones = 0;
+		for (int i = 0; i < width / 2; ++i)
+		{
+			zeros += letters[first + i];
+			ones += letters[first + width / 2 + i];
+		}
+		int probability = static_cast<int>(ones * PROBABILITY_ONE / std::max(zeros + ones, 1LL));
+		return static_cast<uint16_t>(std::min(std::max(probability, 32), PROBABILITY_ONE - 32));
+	}
+
+	/// <summary>
+	/// Zamienia logit w skali 1/256 na prawdopodobienstwo 12-bitowe, interpolujac tablice.
+	/// </summary>
+	static int squash(int d)
+	{
+		static const int table[33] =
+		{
+			1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101, 1546,
+			2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022, 4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094
+		};
+		if (d > 2047)
+			return PROBABILITY_ONE - 1;
+		if (d < -2047)
+			return 1;
+		int w = d & 127;
+		d = (d >> 7) + 16;
+		return (table[d] * (128 - w) + table[d + 1] * w + 64) >> 7;
+	}
+
+	static std::vector<short> buildStretchTable()
+	{
+		std::vector<short> table(PROBABILITY_ONE);
+		int previous = 0;
+		for (int x = -2047; x <= 2047; ++x)
+		{
+			int value = squash(x);
+			for (int i = previous; i <= value; ++i)
+				table[i] = static_cast<short>(x);
+			previous = value + 1;
+		}
+		for (int i = previous; i < PROBABILITY_ONE; ++i)
+			table[i] = 2047;
+		return table;
+	}
+};
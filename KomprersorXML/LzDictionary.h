@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// Nazwany zestaw slownikow sekcji LZSS wyuczony na korpusie plikow. Slownik sekcji umieszczany jest
+/// umownie przed jej danymi, dzieki czemu juz pierwsze bajty malych plikow moga byc dopasowaniami.
+/// Identyfikator zestawu zapisywany jest w naglowku skompresowanego pliku, dlatego dekompresja
+/// wymaga wczytania zestawu o tym samym identyfikatorze.
+/// </summary>
+class LzDictionary
+{
+	/// <summary>
+	/// Poczatek pliku zestawu: sygnatura i wersja formatu
+	/// </summary>
+	static constexpr char const * SIGNATURE = "KXD\x01";
+	static const size_t SIGNATURE_SIZE = 4;
+
+	/// <summary>
+	/// Dlugosc ciagow, ktorych wystapienia zliczane sa przy uczeniu, i dlugosc fragmentow slownika
+	/// </summary>
+	static const size_t DMER_SIZE = 8;
+	static const size_t SEGMENT_SIZE = 64;
+
+	int _id;
+	std::string _name;
+
+	/// <summary>
+	/// Slowniki kolejnych sekcji LZSS w kolejnosci ich zapisu w pliku skompresowanym
+	/// </summary>
+	std::vector<std::string> _sections;
+
+public:
+	/// <summary>
+	/// Identyfikator oznaczajacy brak slownika
+	/// </summary>
+	static const int NONE = 0;
+
+	/// <summary>
+	/// Najwiekszy rozmiar slownika sekcji; reszta okna LZSS pozostaje na dane pliku
+	/// </summary>
+	static const size_t MAX_SECTION_SIZE = 16 << 10;
+
+	/// <summary>
+	/// Tworzy zestaw z danych wejsciowych sekcji zebranych przy kompresji korpusu. Slownik sekcji
+	/// skladany jest z fragmentow zawierajacych najwiecej ciagow powtarzajacych sie w roznych plikach,
+	/// przy czym najcenniejsze fragmenty trafiaja na koniec, najblizej danych.
+	/// </summary>
+	/// <param name="id">Identyfikator od 1 do 255.</param>
+	/// <param name="name">Nazwa zestawu.</param>
+	/// <param name="samples">Dane wejsciowe kolejnych sekcji, po jednej probce na plik.</param>
+	/// <param name="sectionSize">Najwiekszy rozmiar slownika sekcji.</param>
+	LzDictionary(int id, std::string const & name, std::vector<std::vector<std::string>> const & samples,
+		size_t sectionSize = MAX_SECTION_SIZE)
+		: _id(id), _name(name)
+	{
+		if (id <= NONE || id > 255)
+			throw std::runtime_error("Identyfikator slownika musi nalezec do przedzialu 1-255");
+		if (sectionSize > MAX_SECTION_SIZE)
+			sectionSize = MAX_SECTION_SIZE;
+		for (auto const & section : samples)
+			_sections.push_back(selectSegments(section, sectionSize));
+	}
+
+	int id() const
+	{
+		return _id;
+	}
+
+	std::string const & name() const
+	{
+		return _name;
+	}
+
+	size_t sectionCount() const
+	{
+		return _sections.size();
+	}
+
+	/// <summary>
+	/// Slownik sekcji albo nullptr, jezeli zestaw jej nie obejmuje.
+	/// </summary>
+	std::string const * section(size_t index) const
+	{
+		return index < _sections.size() ? &_sections[index] : nullptr;
+	}
+
+	/// <summary>
+	/// Wczytuje zestaw z pliku zapisanego przez save.
+	/// </summary>
+	/// <param name="path">Sciezka do pliku.</param>
+	static std::shared_ptr<LzDictionary const> load(std::string const & path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Nie mozna otworzyc slownika " + path);
+		char signature[SIGNATURE_SIZE];
+		file.read(signature, SIGNATURE_SIZE);
+		if (!file || !std::equal(signature, signature + SIGNATURE_SIZE, SIGNATURE))
+			throw std::runtime_error("Niepoprawny slownik " + path);
+
+		std::shared_ptr<LzDictionary> dictionary(new LzDictionary());
+		dictionary->_id = file.get();
+		int nameLength = file.get();
+		dictionary->_name.resize(std::max(nameLength, 0));
+		file.read(&dictionary->_name[0], dictionary->_name.size());
+		dictionary->_sections.resize(std::max(file.get(), 0));
+		for (auto & section : dictionary->_sections)
+		{
+			int low = file.get();
+			int high = file.get();
+			size_t size = file ? low | high << 8 : 0;
+			if (size > MAX_SECTION_SIZE)
+				throw std::runtime_error("Niepoprawny slownik " + path);
+			section.resize(size);
+			file.read(&section[0], size);
+		}
+		if (!file || dictionary->_id <= NONE)
+			throw std::runtime_error("Niepoprawny slownik " + path);
+		return dictionary;
+	}
+
+	/// <summary>
+	/// Zapisuje zestaw do pliku; rozmiar slownika sekcji zapisywany jest na 2 bajtach little-endian.
+	/// </summary>
+	/// <param name="path">Sciezka do pliku.</param>
+	void save(std::string const & path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(SIGNATURE, SIGNATURE_SIZE);
+		file.put(static_cast<char>(_id));
+		size_t nameLength = std::min<size_t>(_name.size(), 255);
+		file.put(static_cast<char>(nameLength));
+		file.write(_name.data(), nameLength);
+		file.put(static_cast<char>(_sections.size()));
+		for (auto const & section : _sections)
+		{
+			file.put(static_cast<char>(section.size() & 0xFF));
+			file.put(static_cast<char>(section.size() >> 8 & 0xFF));
+			file.write(section.data(), section.size());
+		}
+		if (!file)
+			throw std::runtime_error("Nie mozna zapisac slownika " + path);
+	}
+
+private:
+	LzDictionary() : _id(NONE)
+	{
+	}
+
+	/// <summary>
+	/// Wybiera fragmenty probek do slownika. Probki dzielone sa na tyle przedzialow, ile fragmentow
+	/// miesci slownik, a z kazdego przedzialu wybierany jest fragment o najwiekszej sumie liczby
+	/// innych plikow zawierajacych jego ciagi. Ciagi wybranego fragmentu przestaja byc punktowane,
+	/// aby kolejne fragmenty nie powtarzaly tej samej tresci.
+	/// </summary>
+	static std::string selectSegments(std::vector<std::string> const & samples, size_t capacity)
+	{
+		// liczba probek zawierajacych kazdy ciag
+		std::unordered_map<uint64_t, int> frequency;
+		std::unordered_set<uint64_t> seen;
+		std::string corpus;
+		for (auto const & sample : samples)
+		{
+			seen.clear();
+			for (size_t i = 0; i + DMER_SIZE <= sample.size(); ++i)
+			{
+				uint64_t dmer = readDmer(sample, i);
+				if (seen.insert(dmer).second)
+					++frequency[dmer];
+			}
+			corpus += sample;
+		}
+
+		struct Segment
+		{
+			size_t begin;
+			long long score;
+		};
+		std::vector<Segment> chosen;
+		size_t segmentCount = capacity / SEGMENT_SIZE;
+		if (segmentCount == 0)
+			return std::string();
+		size_t epochSize = corpus.size() / segmentCount;
+		if (epochSize < SEGMENT_SIZE)
+			epochSize = SEGMENT_SIZE;
+		std::vector<long long> gains;
+		for (size_t epoch = 0; epoch + SEGMENT_SIZE <= corpus.size(); epoch += epochSize)
+		{
+			size_t end = std::min(corpus.size(), epoch + epochSize + SEGMENT_SIZE - 1);
+			// zysk ciagu zaczynajacego sie na kazdej pozycji przedzialu
+			gains.assign(end - epoch - DMER_SIZE + 1, 0);
+			for (size_t i = 0; i < gains.size(); ++i)
+			{
+				auto found = frequency.find(readDmer(corpus, epoch + i));
+				if (found != frequency.end())
+					gains[i] = std::max(found->second - 1, 0);
+			}
+			const size_t window = SEGMENT_SIZE - DMER_SIZE + 1;
+			long long score = 0;
+			for (size_t i = 0; i < window; ++i)
+				score += gains[i];
+			Segment best = { epoch, score };
+			for (size_t i = window; i < gains.size(); ++i)
+			{
+				score += gains[i] - gains[i - window];
+				if (score > best.score)
+					best = { epoch + i - window + 1, score };
+			}
+			if (best.score <= 0)
+				continue;
+			for (size_t i = best.begin; i + DMER_SIZE <= best.begin + SEGMENT_SIZE; ++i)
+			{
+				auto found = frequency.find(readDmer(corpus, i));
+				if (found != frequency.end())
+					found->second = 0;
+			}
+			chosen.push_back(best);
+		}
+
+		// najcenniejsze fragmenty na koniec slownika, gdzie odleglosci do danych sa najmniejsze
+		std::stable_sort(chosen.begin(), chosen.end(), [](Segment const & a, Segment const & b)
+		{
+			return a.score > b.score;
+		});
+		if (chosen.size() > segmentCount)
+			chosen.resize(segmentCount);
+		std::string dictionary;
+		for (auto it = chosen.rbegin(); it != chosen.rend(); ++it)
+			dictionary.append(corpus, it->begin, SEGMENT_SIZE);
+		return dictionary;
+	}
+
+	static uint64_t readDmer(std::string const & data, size_t position)
+	{
+		uint64_t dmer = 0;
+		for (size_t i = 0; i < DMER_SIZE; ++i)
+			dmer = dmer << 8 | static_cast<unsigned char>(data[position + i]);
+		return dmer;
+	}
+};
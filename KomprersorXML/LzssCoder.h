@@ -2,9 +2,17 @@
 #include "port.h"
 #include "qsmodel.h"
 #include "rangecod.h"
-#include <io.h>
-#include <fcntl.h>
+#include "RangeCoderStream.h"
+#include "LiteralContextModel.h"
+#include "BinaryRangeCoder.h"
+#include "RansCoder.h"
+#include "HuffmanCoder.h"
+#include "WideRangeCoder.h"
+#include <memory>
 #include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <unordered_map>
 
@@ -23,18 +31,54 @@ protected:
 
 	// zmienne zwiazane z biblioteka range coder
 	rangecoder rc;
-	qsmodel flagModel, letterModel, offsetModel;
+	qsmodel flagModel, letterModel, offsetModel, runModel;
+
+	/// <summary>
+	/// Model flagi po ciagu liter krotszym od MAX_RUN_LENGTH, po ktorym nie moze wystapic litera
+	/// </summary>
+	qsmodel runFlagModel;
 	static const int LENGTH_MODEL_SIZE = MAX_OFFSET_BITS + 1;
 	qsmodel lengthModel[LENGTH_MODEL_SIZE];
+
+	/// <summary>
+	/// Przy kontekstach dlugosci model dlugosci wybiera grupa logarytmu odleglosci i grupa dlugosci
+	/// poprzedniego dopasowania zamiast samego logarytmu odleglosci
+	/// </summary>
+	static const int LENGTH_OFFSET_GROUPS = 3;
+	static const int LENGTH_HISTORY_GROUPS = 4;
+	static const int LENGTH_CONTEXT_MODELS = LENGTH_OFFSET_GROUPS * LENGTH_HISTORY_GROUPS;
 	static const int FLAG_ALPHABET_SIZE = 3;
+
+	/// <summary>
+	/// Liczba zapamietanych ostatnich odleglosci; dopasowanie z jedna z nich kodowane jest
+	/// sama flaga FIRST_REPEAT_FLAG + numer odleglosci i dlugoscia
+	/// </summary>
+	static const int REPEAT_COUNT = 4;
+	static const int FIRST_REPEAT_FLAG = FLAG_ALPHABET_SIZE;
+	static const int REPEAT_FLAG_ALPHABET_SIZE = FLAG_ALPHABET_SIZE + REPEAT_COUNT;
 	static const int LETTER_ALPHABET_SIZE = 257;
 	static const int OFFSET_ALPHABET_SIZE = 252;
 	static const int LENGTH_ALPHABET_SIZE = MAX_LENGTH;
+
+	/// <summary>
+	/// Najdluzszy ciag liter zapisywany jedna flaga; dluzsze ciagi dzielone sa na kolejne
+	/// </summary>
+	static const int MAX_RUN_LENGTH = 64;
 	static const int LG_TOTF = 12;
-	static const int RESCALE = 2000;
 	static const int COMPRESS = 1;
 	static const int DECOMPRESS = 0;
 	static const int MAX_LITTLE_OFFSET = 250;
+
+	/// <summary>
+	/// Przy przedzialach odleglosci po symbolu 251 zapisywany jest numer przedzialu odleglosci (offsetSlot)
+	/// w modelu przedzialow, FOOTER_MODEL_BITS najstarszych bitow w przedziale w modelu tego przedzialu
+	/// i pozostale bity wprost. Pierwszy przedzial to offsetSlot(MAX_LITTLE_OFFSET).
+	/// </summary>
+	static const int FIRST_LONG_OFFSET_SLOT = 15;
+	static const int LONG_OFFSET_SLOT_COUNT = 2 * MAX_OFFSET_BITS - FIRST_LONG_OFFSET_SLOT;
+	static const int FOOTER_MODEL_BITS = 3;
+	qsmodel slotModel;
+	qsmodel footerModel[LONG_OFFSET_SLOT_COUNT];
 	static const char START_SIGN = '!';
 	
 	/// <summary>
@@ -47,372 +91,2159 @@ protected:
 	typedef std::unordered_map<long, PositionVector> MyMap;
 	MyMap myMap;
 
-public:
 	/// <summary>
-	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// Tryb, rozmiar alfabetu i liczba modeli dlugosci, dla ktorych zaalokowane sa modele; modele sa zerowane
+	/// i uzywane ponownie w kolejnych sekcjach i plikach
+	/// </summary>
+	int _modelMode, _modelAlphabetSize, _modelLengthCount;
+	bool _modelsReady;
+
+	/// <summary>
+	/// Dlugosc poczatku danych sekcji, na ktorej wybierane sa parametry modeli
+	/// </summary>
+	static const int PARAMETER_SAMPLE_SIZE = 1 << 16;
+
+public:
+	/// <summary>
+	/// Czestosci symboli modeli jednej sekcji: zliczone przy uczeniu albo, po normalizacji,
+	/// poczatkowe czestosci modeli
+	/// </summary>
+	struct Frequencies
+	{
+		std::vector<int> flags, letters, offsets;
+		std::vector<int> lengths[LENGTH_MODEL_SIZE];
+
+		/// <summary>
+		/// Zeruje liczniki wszystkich modeli.
+		/// </summary>
+		void clear(int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+		{
+			flags.assign(FLAG_ALPHABET_SIZE, 0);
+			letters.assign(letterAlphabetSize, 0);
+			offsets.assign(OFFSET_ALPHABET_SIZE, 0);
+			for (auto & length : lengths)
+				length.assign(LENGTH_ALPHABET_SIZE, 0);
+		}
+
+		void add(Frequencies const & other)
+		{
+			addCounts(flags, other.flags);
+			addCounts(letters, other.letters);
+			addCounts(offsets, other.offsets);
+			for (int i = 0; i < LENGTH_MODEL_SIZE; ++i)
+				addCounts(lengths[i], other.lengths[i]);
+		}
+
+		/// <summary>
+		/// Zamienia liczniki na poczatkowe czestosci modeli: kazdy symbol otrzymuje co najmniej 1,
+		/// a suma czestosci kazdego modelu wynosi 1 &lt;&lt; LG_TOTF.
+		/// </summary>
+		void normalize()
+		{
+			normalizeCounts(flags);
+			normalizeCounts(letters);
+			normalizeCounts(offsets);
+			for (auto & length : lengths)
+				normalizeCounts(length);
+		}
+
+		/// <summary>
+		/// Sprawdza, czy czestosci moga zainicjalizowac modele.
+		/// </summary>
+		bool isValidPrior() const
+		{
+			bool valid = isValidCounts(flags, FLAG_ALPHABET_SIZE) && isValidCounts(letters, letters.size())
+				&& isValidCounts(offsets, OFFSET_ALPHABET_SIZE);
+			for (auto const & length : lengths)
+				valid = valid && isValidCounts(length, LENGTH_ALPHABET_SIZE);
+			return valid;
+		}
+
+	private:
+		static void addCounts(std::vector<int> & counts, std::vector<int> const & other)
+		{
+			counts.resize(std::max(counts.size(), other.size()));
+			for (size_t i = 0; i < other.size(); ++i)
+				counts[i] += other[i];
+		}
+
+		static void normalizeCounts(std::vector<int> & counts)
+		{
+			const int total = 1 << LG_TOTF;
+			const int n = static_cast<int>(counts.size());
+			long long sum = 0;
+			for (int count : counts)
+				sum += count;
+			std::vector<int> order(n);
+			for (int i = 0; i < n; ++i)
+				order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&counts](int a, int b) { return counts[a] > counts[b]; });
+			int assigned = 0;
+			for (int & count : counts)
+			{
+				count = 1 + (sum == 0 ? (total - n) / n : static_cast<int>(count * static_cast<long long>(total - n) / sum));
+				assigned += count;
+			}
+			// reszta z zaokraglen trafia do najczestszych symboli
+			for (int i = 0; assigned < total; i = (i + 1) % n, ++assigned)
+				++counts[order[i]];
+		}
+
+		static bool isValidCounts(std::vector<int> const & counts, size_t size)
+		{
+			if (counts.size() != size || size == 0)
+				return false;
+			int sum = 0;
+			for (int count : counts)
+			{
+				if (count < 1)
+					return false;
+				sum += count;
+			}
+			return sum == 1 << LG_TOTF;
+		}
+	};
+
+protected:
+	/// <summary>
+	/// Poczatkowe czestosci modeli albo nullptr
+	/// </summary>
+	Frequencies const * _prior;
+
+	/// <summary>
+	/// Liczniki symboli uczonego zestawu czestosci albo nullptr
+	/// </summary>
+	Frequencies * _statistics;
+
+	/// <summary>
+	/// Slownik umieszczany umownie przed danymi sekcji albo nullptr
+	/// </summary>
+	std::string const * _dictionary;
+
+	/// <summary>
+	/// Pozycje ciagow slownika wedlug skrotu; budowane przy pierwszej kompresji ze slownikiem
+	/// i niezmieniane przez kolejne pliki
+	/// </summary>
+	MyMap _dictionaryMap;
+	bool _dictionaryIndexed;
+
+	/// <summary>
+	/// Slownik i dane sekcji w jednym buforze kompresji
+	/// </summary>
+	std::string _window;
+
+	/// <summary>
+	/// Zebrane dane wejsciowe kolejnych kompresji albo nullptr
+	/// </summary>
+	std::vector<std::string> * _samples;
+
+	/// <summary>
+	/// Czy litery kodowane sa modelem kontekstowym zamiast letterModel
+	/// </summary>
+	bool _literalContexts;
+
+	/// <summary>
+	/// Kontekstowy model liter tworzony przy pierwszym uzyciu
+	/// </summary>
+	std::unique_ptr<LiteralContextModel> _literalModel;
+
+	/// <summary>
+	/// Czy dopasowania z ostatnimi odleglosciami kodowane sa osobnymi flagami
+	/// </summary>
+	bool _repeatOffsets;
+
+	/// <summary>
+	/// Ostatnie rozne odleglosci dopasowan, od najnowszej
+	/// </summary>
+	unsigned int _repeats[REPEAT_COUNT];
+
+	/// <summary>
+	/// Czy litery zapisywane sa ciagami: jedna flaga i dlugosc ciagu przed literami
+	/// </summary>
+	bool _literalRuns;
+
+	/// <summary>
+	/// Pozycja pierwszej litery i dlugosc ciagu liter czekajacego na zapis przy kompresji
+	/// </summary>
+	int _runStart, _runLength;
+
+	/// <summary>
+	/// Czy kolejna flaga nastepuje po ciagu liter krotszym od MAX_RUN_LENGTH
+	/// </summary>
+	bool _afterRun;
+
+	/// <summary>
+	/// Czy dlugie odleglosci zapisywane sa przedzialami zamiast symbolem 251 i 15 bitami wprost
+	/// </summary>
+	bool _offsetSlots;
+
+	/// <summary>
+	/// Czy model dlugosci zalezy od dlugosci poprzedniego dopasowania
+	/// </summary>
+	bool _lengthContexts;
+
+	/// <summary>
+	/// Dlugosc poprzedniego dopasowania sekcji
+	/// </summary>
+	int _lastLength;
+
+public:
+	/// <summary>
+	/// Koder entropijny sekcji
+	/// </summary>
+	enum Backend : char
+	{
+		/// <summary>
+		/// Koder zakresowy z rangecod z modelami czestosci qsmodel
+		/// </summary>
+		RANGE_CODER = 0,
+		/// <summary>
+		/// Binarny koder zakresowy z modelami bitow w stylu LZMA
+		/// </summary>
+		BINARY_CODER = 1,
+		/// <summary>
+		/// Przeplatany koder rANS z czestosciami symboli zapisanymi dla kazdego bloku; litery
+		/// kodowane sa zawsze modelem rzedu 0
+		/// </summary>
+		RANS_CODER = 2,
+		/// <summary>
+		/// Kanoniczne kody Huffmana wyznaczane dla kazdego bloku; najszybsza kompresja i dekompresja
+		/// kosztem stopnia kompresji
+		/// </summary>
+		HUFFMAN_CODER = 3,
+		/// <summary>
+		/// Modele czestosci qsmodel z koderem zakresowym o 64-bitowym low, normalizowanym 32-bitowymi slowami
+		/// </summary>
+		WIDE_RANGE_CODER = 4
+	};
+
+	/// <summary>
+	/// Grupy modeli qsmodel z osobnymi parametrami; modele dlugosci maja wspolne parametry
+	/// </summary>
+	enum ModelGroup
+	{
+		FLAG_MODELS,
+		LETTER_MODELS,
+		OFFSET_MODELS,
+		LENGTH_MODELS,
+		MODEL_GROUP_COUNT
+	};
+
+	/// <summary>
+	/// Parametry modeli qsmodel kazdej grupy, po jednym bajcie: starsze cztery bity to LG_TOTF
+	/// pomniejszone o 12, mlodsze to wykladnik odstepu miedzy przeskalowaniami RESCALE_BASE &lt;&lt; n.
+	/// Wieksza suma czestosci pozwala dokladniej przyblizyc rzadkie symbole, a krotszy odstep
+	/// szybciej dostosowuje model do zmian rozkladu.
+	/// </summary>
+	struct ModelParameters
+	{
+		static const int RESCALE_BASE = 250;
+		static const int MAX_LG_TOTF = 15;
+		static const int MAX_RESCALE_SHIFT = 7;
+
+		/// <summary>
+		/// Suma czestosci 1 &lt;&lt; 12 i 2000 symboli miedzy przeskalowaniami, jak w plikach bez zapisanych parametrow
+		/// </summary>
+		static const unsigned char DEFAULT = 0x03;
+
+		unsigned char groups[MODEL_GROUP_COUNT];
+
+		ModelParameters()
+		{
+			for (auto & group : groups)
+				group = DEFAULT;
+		}
+
+		bool isDefault() const
+		{
+			return *this == ModelParameters();
+		}
+
+		bool operator==(ModelParameters const & other) const
+		{
+			return std::equal(groups, groups + MODEL_GROUP_COUNT, other.groups);
+		}
+
+		static int lgTotf(unsigned char code)
+		{
+			return LG_TOTF + (code >> 4);
+		}
+
+		static int rescale(unsigned char code)
+		{
+			return RESCALE_BASE << (code & 0xF);
+		}
+
+		static unsigned char code(int lgTotf, int rescaleShift)
+		{
+			return static_cast<unsigned char>((lgTotf - LG_TOTF) << 4 | rescaleShift);
+		}
+
+		/// <summary>
+		/// Sprawdza, czy bajt opisuje parametry przyjmowane przez qsmodel.
+		/// </summary>
+		static bool isValid(unsigned char code)
+		{
+			return lgTotf(code) <= MAX_LG_TOTF && (code & 0xF) <= MAX_RESCALE_SHIFT && rescale(code) < 1 << (lgTotf(code) + 1);
+		}
+	};
+
+protected:
+	Backend _backend;
+	BinaryRangeCoder _binary;
+	WideRangeCoder _wide;
+
+	/// <summary>
+	/// Przekazuje bity modelu kontekstowego liter do kodera zakresowego sekcji z modelami qsmodel.
+	/// </summary>
+	struct ShiftCoderBits
+	{
+		LzssCoder & coder;
+
+		void encodePredicted(int probability, int bit)
+		{
+			const int one = 1 << LiteralContextModel::PROBABILITY_BITS;
+			if (bit)
+				coder.encodeShift(probability, 0, LiteralContextModel::PROBABILITY_BITS);
+			else
+				coder.encodeShift(one - probability, probability, LiteralContextModel::PROBABILITY_BITS);
+		}
+
+		int decodePredicted(int probability)
+		{
+			const int one = 1 << LiteralContextModel::PROBABILITY_BITS;
+			int bit = coder.decodeShift(LiteralContextModel::PROBABILITY_BITS) < (freq)probability;
+			if (bit)
+				coder.decodeUpdate(probability, 0, LiteralContextModel::PROBABILITY_BITS);
+			else
+				coder.decodeUpdate(one - probability, probability, LiteralContextModel::PROBABILITY_BITS);
+			return bit;
+		}
+	};
+
+	typedef BinaryRangeCoder::Probability Probability;
+
+	// parametry modeli binarnego kodera
+	static const int STATE_COUNT = 4;
+	static const int LITERAL_CONTEXT_BITS = 3;
+	static const int OFFSET_SLOT_BITS = 5;
+	static const int FIRST_FOOTER_SLOT = 4;
+	static const int FIRST_DIRECT_SLOT = 14;
+	static const int ALIGN_BITS = 4;
+	static const int LENGTH_CONTEXT_COUNT = 4;
+	static const int LENGTH_LOW_BITS = 3;
+	static const int LENGTH_HIGH_BITS = 8;
+
+	/// <summary>
+	/// Modele bitow binarnego kodera. Stan to rodzaje dwoch ostatnich symboli (litera lub dopasowanie).
+	/// Odleglosc dzielona jest jak w LZMA na numer przedzialu i bity w przedziale, a dlugosc dopasowania
+	/// kodowana jest w kontekscie grupy przedzialow odleglosci.
+	/// </summary>
+	struct BitModels
+	{
+		Probability isMatch[STATE_COUNT];
+		Probability isEnd;
+		Probability literals[1 << LITERAL_CONTEXT_BITS][1 << 8];
+		Probability offsetSlots[1 << OFFSET_SLOT_BITS];
+		Probability offsetFooters[FIRST_DIRECT_SLOT][1 << (FIRST_DIRECT_SLOT / 2 - 1)];
+		Probability offsetAlign[1 << ALIGN_BITS];
+		Probability lengthChoice[LENGTH_CONTEXT_COUNT];
+		Probability lengthChoice2[LENGTH_CONTEXT_COUNT];
+		Probability lengthLow[LENGTH_CONTEXT_COUNT][1 << LENGTH_LOW_BITS];
+		Probability lengthMid[LENGTH_CONTEXT_COUNT][1 << LENGTH_LOW_BITS];
+		Probability lengthHigh[1 << LENGTH_HIGH_BITS];
+	};
+	BitModels _bitModels;
+
+	/// <summary>
+	/// Stan binarnego kodera przy kompresji
+	/// </summary>
+	int _state;
+
+	/// <summary>
+	/// Najwieksza liczba symboli LZSS (liter i dopasowan) w bloku koderow ze statycznymi modelami
+	/// </summary>
+	static const int BLOCK_SIZE = 1 << 16;
+
+	/// <summary>
+	/// Symbol LZSS zapamietany do zakodowania bloku koderem rANS albo kodami Huffmana;
+	/// odleglosc 0 oznacza litere
+	/// </summary>
+	struct BlockToken
+	{
+		uint16_t offset;
+		uint8_t value;
+
+		/// <summary>
+		/// Numer powtorzonej odleglosci powiekszony o 1 albo 0; uzywany tylko przy wyborze parametrow modeli
+		/// </summary>
+		uint8_t repeat;
+	};
+	std::vector<BlockToken> _blockTokens;
+
+	// statyczne modele kodera rANS: flaga litery, litera, numer przedzialu odleglosci i dlugosc
+	RansCoder::Model _ransFlags, _ransLetters, _ransOffsets, _ransLengths;
+	RansCoder _rans;
+
+	/// <summary>
+	/// Kody Huffmana bloku: wspolny alfabet liter i dlugosci dopasowan (po literach) oraz numery
+	/// przedzialow odleglosci
+	/// </summary>
+	HuffmanCoder::Table _huffmanSymbols, _huffmanOffsets;
+	static const int HUFFMAN_SYMBOL_COUNT = (1 << 8) + MAX_LENGTH;
+
+	/// <summary>
+	/// Parametry modeli kolejnej sekcji i parametry, z ktorymi zaalokowane sa modele
+	/// </summary>
+	ModelParameters _parameters, _modelParameters;
+
+	/// <summary>
+	/// Czy przy kompresji parametry modeli wybierane sa na poczatku danych sekcji
+	/// </summary>
+	bool _parameterSearch;
+
+	/// <summary>
+	/// Czy przy kompresji konteksty modeli dlugosci wlaczane sa tylko, jezeli dlugosci sekcji
+	/// zajmuja z nimi mniej bitow niz w modelach wedlug logarytmu odleglosci
+	/// </summary>
+	bool _lengthContextSearch;
+
+	/// <summary>
+	/// Czy symbole LZSS sa tylko zbierane do _blockTokens, bez kodowania
+	/// </summary>
+	bool _collectTokens;
+
+	/// <summary>
+	/// Poczatkowe czestosci flag uzupelnione o flagi powtorzonych odleglosci i czestosci
+	/// przeskalowane do sumy czestosci modelu
+	/// </summary>
+	std::vector<int> _extendedPrior, _scaledPrior;
+
+	/// <summary>
+	/// Poczatkowe czestosci modelu dlugosci ciagow liter
+	/// </summary>
+	std::vector<int> _runFrequencies;
+
+public:
+	LzssCoder() : _modelsReady(false), _prior(nullptr), _statistics(nullptr), _dictionary(nullptr),
+		_dictionaryIndexed(false), _samples(nullptr), _literalContexts(false), _repeatOffsets(false), _literalRuns(false), _runStart(0), _runLength(0), _afterRun(false), _offsetSlots(false), _lengthContexts(false), _lastLength(MIN_LENGTH),
+		_backend(RANGE_CODER), _state(0),
+		_ransFlags(2), _ransLetters(1 << 8), _ransOffsets(1 << OFFSET_SLOT_BITS), _ransLengths(MAX_LENGTH),
+		_huffmanSymbols(HUFFMAN_SYMBOL_COUNT), _huffmanOffsets(1 << OFFSET_SLOT_BITS), _parameterSearch(false), _lengthContextSearch(false), _collectTokens(false)
+	{
+	}
+
+	/// <summary>
+	/// Ustawia poczatkowe czestosci modeli kolejnych sekcji; nullptr oznacza rozklad rownomierny.
+	/// Koder i dekoder sekcji musza uzywac tych samych czestosci.
+	/// </summary>
+	void setPrior(Frequencies const * prior)
+	{
+		_prior = prior;
+	}
+
+	/// <summary>
+	/// Ustawia liczniki, do ktorych przy kompresji dodawane sa zapisywane symbole; nullptr wylacza zliczanie.
+	/// </summary>
+	void setStatistics(Frequencies * statistics)
+	{
+		_statistics = statistics;
+	}
+
+	/// <summary>
+	/// Ustawia slownik, do ktorego dopasowania moga odwolywac sie od pierwszego bajtu sekcji;
+	/// nullptr wylacza slownik. Koder i dekoder sekcji musza uzywac tego samego slownika,
+	/// a slownik musi istniec do kolejnego wywolania.
+	/// </summary>
+	void setDictionary(std::string const * dictionary)
+	{
+		_dictionary = dictionary && !dictionary->empty() ? dictionary : nullptr;
+		_dictionaryIndexed = false;
+	}
+
+	/// <summary>
+	/// Wybiera koder entropijny kolejnych sekcji. Koder i dekoder sekcji musza uzywac tego samego kodera.
+	/// </summary>
+	void setBackend(Backend backend)
+	{
+		_backend = backend;
+	}
+
+	/// <summary>
+	/// Wlacza kodowanie liter w kontekscie dwoch poprzednich bajtow sekcji zamiast modelem rzedu 0.
+	/// Koder i dekoder sekcji musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setLiteralContexts(bool enabled)
+	{
+		_literalContexts = enabled;
+	}
+
+	/// <summary>
+	/// Wlacza kodowanie dopasowan z jedna z REPEAT_COUNT ostatnich odleglosci sama flaga, bez odleglosci.
+	/// Dotyczy koderow z modelami qsmodel; koder i dekoder sekcji musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setRepeatOffsets(bool enabled)
+	{
+		_repeatOffsets = enabled;
+	}
+
+	/// <summary>
+	/// Wlacza zapis kolejnych liter ciagami: flaga litery, dlugosc ciagu do MAX_RUN_LENGTH i litery,
+	/// zamiast flagi przed kazda litera. Dotyczy koderow z modelami qsmodel; koder i dekoder sekcji
+	/// musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setLiteralRuns(bool enabled)
+	{
+		_literalRuns = enabled;
+	}
+
+	/// <summary>
+	/// Wlacza zapis odleglosci wiekszych od MAX_LITTLE_OFFSET numerem przedzialu i modelowanymi
+	/// najstarszymi bitami w przedziale. Dotyczy koderow z modelami qsmodel; koder i dekoder sekcji
+	/// musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setOffsetSlots(bool enabled)
+	{
+		_offsetSlots = enabled;
+	}
+
+	/// <summary>
+	/// Wlacza wybor modelu dlugosci wedlug grupy odleglosci i dlugosci poprzedniego dopasowania.
+	/// Dotyczy koderow z modelami qsmodel; koder i dekoder sekcji musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setLengthContexts(bool enabled)
+	{
+		_lengthContexts = enabled;
+	}
+
+	/// <summary>
+	/// Wlacza porownanie obu rodzajow modeli dlugosci na danych kazdej kompresowanej sekcji.
+	/// Dotyczy koderow z modelami qsmodel; wybrane ustawienie zwraca lengthContexts.
+	/// </summary>
+	void setLengthContextSearch(bool enabled)
+	{
+		_lengthContextSearch = enabled;
+	}
+
+	/// <summary>
+	/// Czy ostatnio skompresowana sekcja ma modele dlugosci w kontekscie dlugosci poprzedniego dopasowania;
+	/// dekoder sekcji musi otrzymac to ustawienie przez setLengthContexts.
+	/// </summary>
+	bool lengthContexts() const
+	{
+		return usesLengthContexts();
+	}
+
+	/// <summary>
+	/// Wlacza wybor parametrow modeli qsmodel kazdej kompresowanej sekcji na poczatku jej danych.
+	/// Dotyczy koderow z modelami qsmodel; wybrane parametry zwraca parameters.
+	/// </summary>
+	void setParameterSearch(bool enabled)
+	{
+		_parameterSearch = enabled;
+	}
+
+	/// <summary>
+	/// Parametry modeli ostatnio skompresowanej sekcji; dekoder sekcji musi otrzymac je przez setParameters.
+	/// </summary>
+	ModelParameters const & parameters() const
+	{
+		return _parameters;
+	}
+
+	/// <summary>
+	/// Ustawia parametry modeli kolejnych sekcji; wybor parametrow przy kompresji je zastepuje.
+	/// </summary>
+	void setParameters(ModelParameters const & parameters)
+	{
+		_parameters = parameters;
+	}
+
+	/// <summary>
+	/// Ustawia wektor, do ktorego przy kompresji dodawane sa dane wejsciowe sekcji; nullptr wylacza zbieranie.
+	/// </summary>
+	void setSamples(std::vector<std::string> * samples)
+	{
+		_samples = samples;
+	}
+
+	~LzssCoder()
+	{
+		if (_modelsReady)
+			deleteModels();
+	}
+
+	/// <summary>
+	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// </summary>
+	/// <param name="source">Zrodlo znakow.</param>
+	/// <param name="target">Zawartosc pliku wyjsciowego, na koniec ktorej dopisywana jest sekcja.</param>
+	/// <param name="letterAlphabetSize">Rozmiar alfabetu wejsciowego.</param>
+	void encode(std::string const & source, std::vector<char> & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	{
+		toBuffer(source);
+		encode(target, letterAlphabetSize);
+		delete[] _buffer;
+	}
+
+	/// <summary>
+	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// </summary>
+	/// <param name="source">Zrodlo znakow.</param>
+	/// <param name="target">Zawartosc pliku wyjsciowego, na koniec ktorej dopisywana jest sekcja.</param>
+	/// <param name="letterAlphabetSize">Rozmiar alfabetu wejsciowego.</param>
+	void encode(std::vector<int> const & source, std::vector<char> & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	{
+		toBuffer(source);
+		encode(target, letterAlphabetSize);
+		delete[] _buffer;
+	}
+
+	/// <summary>
+	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// </summary>
+	/// <param name="source">Zrodlo znakow.</param>
+	/// <param name="target">Zawartosc pliku wyjsciowego, na koniec ktorej dopisywana jest sekcja.</param>
+	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
+	void encode(std::vector<std::string> const & source, std::vector<char> & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	{
+		toBuffer(source);
+		encode(target, letterAlphabetSize);
+		delete[] _buffer;
+	}
+
+	/// <summary>
+	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// </summary>
+	/// <param name="source">Zrodlo znakow.</param>
+	/// <param name="target">Zawartosc pliku wyjsciowego, na koniec ktorej dopisywana jest sekcja.</param>
+	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
+	void encode(std::vector<char> const & source, std::vector<char> & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	{
+		toBuffer(source);
+		encode(target, letterAlphabetSize);
+	}
+
+	/// <summary>
+	/// Dekompresuje sekcje pliku zrodlowego do ciagu znakow.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja od ktorej rozpoczac dekompresje.</param>
+	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
+	/// <returns>Zdekompresowany ciag znakow</returns>
+	std::string decode(std::vector<char> const & source, int & pos, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	{
+		// dopasowania moga kopiowac ze slownika poprzedzajacego dane
+		std::string output = _dictionary ? *_dictionary : std::string();
+		initializeModels(DECOMPRESS, letterAlphabetSize);
+		if (_backend == BINARY_CODER)
+			decodeBinary(source, pos, output);
+		else if (_backend == RANS_CODER)
+			decodeRans(source, pos, output);
+		else if (_backend == HUFFMAN_CODER)
+			decodeHuffman(source, pos, output);
+		else
+			decodeRange(source, pos, output);
+		if (_dictionary)
+			output.erase(0, _dictionary->size());
+		return output;
+	}
+
+	/// <summary>
+	/// Ustawia wskaznik pozycji na kolejne sekcje range codera
+	/// </summary>
+	/// <param name="source">Zawartosc pliku.</param>
+	/// <param name="pos">Pozycja w pliku, zostaje zmieniona.</param>
+	void changePositionForRangeCoder(std::vector<char> const & source, int & pos)
+	{
+		auto found = std::find(source.begin() + pos, source.end(), char(START_SIGN));
+		if (found == source.end())
+			throw std::runtime_error("Brak kolejnej sekcji range codera");
+		pos = static_cast<int>(found - source.begin());
+	}
+
+protected:
+	/// <summary>
+	/// Dekompresuje symbole sekcji zapisanej koderem z rangecod i modelami qsmodel.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja poczatku sekcji, zostaje przesunieta za sekcje.</param>
+	/// <param name="output">Wyjscie poprzedzone slownikiem.</param>
+	void decodeRange(std::vector<char> const & source, int & pos, std::string & output)
+	{
+		int start = pos;
+		int ch, sysfreq, ltfreq;
+		// rozpoczecie dekompresji
+		if (_backend == WIDE_RANGE_CODER)
+			_wide.startDecoding(source, pos + 1);
+		else
+		{
+			RangeCoderStream::attachSource(rc, source, pos);
+			start_decoding(&rc);
+		}
+		resetRepeats();
+		_afterRun = false;
+		_lastLength = MIN_LENGTH;
+		int symbol;
+		while (true)
+		{
+			qsmodel & flags = currentFlagModel();
+			ltfreq = decodeShift(flags.lgtotf);
+			// odczytanie flagi
+			symbol = qsgetsym(&flags, ltfreq);
+			if (symbol == 2)
+			{
+				// koniec pliku; WideRangeCoder normalizuje sie po symbolu, wiec musi odczytac takze ten
+				if (_backend == WIDE_RANGE_CODER)
+					loadSymbol(flags, symbol, sysfreq, ltfreq);
+				break;
+			}
+			loadSymbol(flags, symbol, sysfreq, ltfreq);
+			_afterRun = false;
+			// litera albo ciag liter
+			if (symbol == 1)
+			{
+				int count = 1;
+				if (usesLiteralRuns())
+				{
+					ltfreq = decodeShift(runModel.lgtotf);
+					int run = qsgetsym(&runModel, ltfreq);
+					loadSymbol(runModel, run, sysfreq, ltfreq);
+					count = run + 1;
+					_afterRun = count < MAX_RUN_LENGTH;
+				}
+				for (int i = 0; i < count; ++i)
+				{
+					if (_literalContexts)
+					{
+						size_t length = output.length();
+						ShiftCoderBits bits = { *this };
+						output += _literalModel->decode(bits, length > 0 ? output[length - 1] : 0, length > 1 ? output[length - 2] : 0);
+					}
+					else
+					{
+						ltfreq = decodeShift(letterModel.lgtotf);
+						int letter = qsgetsym(&letterModel, ltfreq);
+						loadSymbol(letterModel, letter, sysfreq, ltfreq);
+						output += letter;
+					}
+				}
+			}
+			else
+			{
+				unsigned short newOffset;
+				if (symbol >= FIRST_REPEAT_FLAG)
+					newOffset = useRepeat(symbol - FIRST_REPEAT_FLAG);
+				else
+				{
+					ltfreq = decodeShift(offsetModel.lgtotf);
+					// offset
+					unsigned char offset = qsgetsym(&offsetModel, ltfreq);
+					loadSymbol(offsetModel, offset, sysfreq, ltfreq);
+					newOffset = offset;
+					if (newOffset > MAX_LITTLE_OFFSET)
+					{
+						if (usesOffsetSlots())
+							newOffset = decodeLongOffset();
+						else
+							newOffset += decodeNBits(MAX_OFFSET_BITS);
+					}
+					if (usesRepeatOffsets())
+						pushRepeat(newOffset);
+				}
+				if (newOffset == 0 || newOffset > output.length())
+					throw std::runtime_error("Niepoprawna sekcja range codera");
+				qsmodel & model = lengthModel[lengthModelIndex(newOffset, _lastLength)];
+				ltfreq = decodeShift(model.lgtotf);
+				// dlugosc
+				unsigned char length = qsgetsym(&model, ltfreq);
+				loadSymbol(model, length, sysfreq, ltfreq);
+				_lastLength = length;
+				int curPosition = output.length();
+				int position = curPosition - newOffset;
+				std::string seqToCopy = output.substr(position, length);
+				output += seqToCopy;
+			}
+		}
+		if (_backend == WIDE_RANGE_CODER)
+			pos = _wide.sectionEnd(source);
+		else
+		{
+			done_decoding(&rc);
+			pos = RangeCoderStream::sectionEnd(rc, source, start);
+		}
+	}
+
+	/// <summary>
+	/// Dekompresuje symbole sekcji zapisanej binarnym koderem zakresowym.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja poczatku sekcji, zostaje przesunieta za sekcje.</param>
+	/// <param name="output">Wyjscie poprzedzone slownikiem.</param>
+	void decodeBinary(std::vector<char> const & source, int & pos, std::string & output)
+	{
+		// pierwszy bajt sekcji to znak jej poczatku
+		_binary.startDecoding(source, pos + 1);
+		int state = 0;
+		while (true)
+		{
+			size_t length = output.length();
+			unsigned char previous = length > 0 ? output[length - 1] : 0;
+			if (!_binary.decodeBit(_bitModels.isMatch[state]))
+			{
+				if (_literalContexts)
+					output += _literalModel->decode(_binary, previous, length > 1 ? output[length - 2] : 0);
+				else
+					output += static_cast<char>(_binary.decodeTree(_bitModels.literals[previous >> (8 - LITERAL_CONTEXT_BITS)], 8));
+				state = nextState(state, false);
+				continue;
+			}
+			if (_binary.decodeBit(_bitModels.isEnd))
+				break;
+			int slot;
+			unsigned int offset = decodeBinaryOffset(slot);
+			unsigned int matchLength = decodeBinaryLength(slot);
+			if (offset > length)
+				throw std::runtime_error("Niepoprawna sekcja range codera");
+			output += output.substr(length - offset, matchLength);
+			state = nextState(state, true);
+		}
+		pos = _binary.position(source);
+	}
+
+	/// <summary>
+	/// Dekompresuje bloki sekcji zapisanej koderem rANS.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja poczatku sekcji, zostaje przesunieta za sekcje.</param>
+	/// <param name="output">Wyjscie poprzedzone slownikiem.</param>
+	void decodeRans(std::vector<char> const & source, int & pos, std::string & output)
+	{
+		// pierwszy bajt sekcji to znak jej poczatku
+		++pos;
+		while (uint32_t count = RansCoder::readNumber(source, pos))
+		{
+			_ransFlags.load(source, pos);
+			_ransLetters.load(source, pos);
+			_ransOffsets.load(source, pos);
+			_ransLengths.load(source, pos);
+			_rans.startDecoding(source, pos);
+			output.reserve(output.size() + count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (_rans.decode(_ransFlags))
+				{
+					output += static_cast<char>(_rans.decode(_ransLetters));
+					continue;
+				}
+				int slot = _rans.decode(_ransOffsets);
+				unsigned int distance = slot;
+				if (slot >= FIRST_FOOTER_SLOT)
+				{
+					int footerBits = (slot >> 1) - 1;
+					distance = (2 | (slot & 1)) << footerBits;
+					if (footerBits > 8)
+						distance += _rans.decodeBits(footerBits - 8) << 8;
+					distance += _rans.decodeBits(std::min(footerBits, 8));
+				}
+				size_t offset = distance + 1;
+				size_t length = _rans.decode(_ransLengths) + MIN_LENGTH;
+				if (offset > output.length())
+					throw std::runtime_error("Niepoprawna sekcja rANS");
+				size_t from = output.length() - offset;
+				for (size_t j = 0; j < length; ++j)
+					output += output[from + j];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Dekompresuje bloki sekcji zapisanej kodami Huffmana. Pary liter odczytywane sa jednym spojrzeniem do tablicy.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja poczatku sekcji, zostaje przesunieta za sekcje.</param>
+	/// <param name="output">Wyjscie poprzedzone slownikiem.</param>
+	void decodeHuffman(std::vector<char> const & source, int & pos, std::string & output)
+	{
+		const int maxBits = HuffmanCoder::MAX_CODE_LENGTH;
+		// pierwszy bajt sekcji to znak jej poczatku
+		++pos;
+		while (uint32_t count = RansCoder::readNumber(source, pos))
+		{
+			_huffmanSymbols.load(source, pos, 1 << 8);
+			_huffmanOffsets.load(source, pos, 0);
+			uint32_t size = RansCoder::readNumber(source, pos);
+			if (size > source.size() - pos)
+				throw std::runtime_error("Niepoprawna sekcja Huffmana");
+			unsigned char const * data = reinterpret_cast<unsigned char const *>(source.data()) + pos;
+			HuffmanCoder::BitReader reader(data, data + size);
+			pos += size;
+			output.reserve(output.size() + count);
+			for (uint32_t i = 0; i < count;)
+			{
+				reader.refill();
+				auto const & entry = _huffmanSymbols.entry(reader.peek(maxBits));
+				if (entry.pairLength > 0 && i + 1 < count)
+				{
+					output += static_cast<char>(entry.first);
+					output += static_cast<char>(entry.second);
+					reader.skip(entry.pairLength);
+					i += 2;
+					continue;
+				}
+				if (entry.firstLength == 0)
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+				reader.skip(entry.firstLength);
+				++i;
+				if (entry.first < 1 << 8)
+				{
+					output += static_cast<char>(entry.first);
+					continue;
+				}
+				size_t length = entry.first - (1 << 8) + MIN_LENGTH;
+				auto const & slotEntry = _huffmanOffsets.entry(reader.peek(maxBits));
+				if (slotEntry.firstLength == 0)
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+				reader.skip(slotEntry.firstLength);
+				int slot = slotEntry.first;
+				unsigned int distance = slot;
+				if (slot >= FIRST_FOOTER_SLOT)
+				{
+					int footerBits = (slot >> 1) - 1;
+					distance = ((2 | (slot & 1)) << footerBits) + reader.read(footerBits);
+				}
+				size_t offset = distance + 1;
+				if (offset > output.length())
+					throw std::runtime_error("Niepoprawna sekcja Huffmana");
+				size_t from = output.length() - offset;
+				for (size_t j = 0; j < length; ++j)
+					output += output[from + j];
+			}
+		}
+	}
+
+
+	void toBuffer(std::vector<char> const & source)
+	{
+		bufSize = source.size();
+		_buffer = (char*)source.data();
+	}
+
+	void toBuffer(std::string const & source)
+	{
+		bufSize = source.size();
+		_buffer = new char[bufSize + 1];
+		for (int i = 0; i < bufSize; ++i)
+			_buffer[i] = source[i];
+		_buffer[bufSize] = '\0';
+	}
+
+	void toBuffer(std::vector<int> const & source)
+	{
+		bufSize = 0;
+		std::vector<std::string> words;
+		for (std::vector<int>::const_iterator numberIt = source.cbegin(); numberIt != source.cend(); ++numberIt)
+		{
+			std::string number = std::to_string(*numberIt);
+			words.push_back(number);
+			bufSize += number.size();
+			bufSize += 1;
+		}
+		_buffer = new char[bufSize + 1];
+		int index = 0;
+		for (std::vector<std::string>::const_iterator wordIt = words.cbegin(); wordIt != words.cend(); ++wordIt)
+		{
+			for (std::string::const_iterator letterIt = wordIt->cbegin(); letterIt != wordIt->cend(); ++letterIt, ++index)
+			{
+				_buffer[index] = *letterIt;
+			}
+			_buffer[index++] = ' ';
+		}
+		_buffer[bufSize] = '\0';
+	}
+
+	void toBuffer(std::vector<std::string> const & source)
+	{
+		bufSize = 0;
+		for (std::vector<std::string>::const_iterator it = source.cbegin(); it != source.cend(); ++it)
+		{
+			bufSize += it->size();
+			bufSize += 1;
+		}
+		_buffer = new char[bufSize + 1];
+		int index = 0;
+		for (std::vector<std::string>::const_iterator wordIt = source.cbegin(); wordIt != source.cend(); ++wordIt)
+		{
+			for (std::string::const_iterator letterIt = wordIt->cbegin(); letterIt != wordIt->cend(); ++letterIt, ++index)
+			{
+				_buffer[index] = *letterIt;
+			}
+			_buffer[index++] = ' ';
+		}
+		_buffer[bufSize] = '\0';
+	}
+
+	void encode(std::vector<char> & target, int letterAlphabetSize)
+	{
+		myMap.clear();
+		bufPos = 0;
+		if (_samples)
+			_samples->emplace_back(_buffer, bufSize);
+		if (_statistics && (int)_statistics->letters.size() != letterAlphabetSize)
+			_statistics->clear(letterAlphabetSize);
+		// slownik poprzedza dane w jednym buforze, dzieki czemu odleglosci liczone sa tak samo jak w dekoderze
+		char * input = _buffer;
+		int inputSize = bufSize;
+		if (_dictionary)
+		{
+			indexDictionary();
+			_window.assign(*_dictionary);
+			_window.append(_buffer, bufSize);
+			_buffer = &_window[0];
+			bufSize = static_cast<int>(_window.size());
+			bufPos = static_cast<int>(_dictionary->size());
+		}
+		// przy wyborze modeli sekcja jest najpierw dzielona na symbole, a kodowana po wyborze
+		const int start = bufPos;
+		const bool searchModels = (_parameterSearch || _lengthContextSearch) && (_backend == RANGE_CODER || _backend == WIDE_RANGE_CODER);
+		if (searchModels)
+			selectModels(letterAlphabetSize);
+		initializeModels(COMPRESS, letterAlphabetSize);
+		if (_backend == BINARY_CODER)
+		{
+			target.push_back(char(START_SIGN));
+			_binary.startEncoding(target);
+			_state = 0;
+		}
+		else if (_backend == RANS_CODER || _backend == HUFFMAN_CODER)
+		{
+			target.push_back(char(START_SIGN));
+			_blockTokens.clear();
+		}
+		else if (_backend == WIDE_RANGE_CODER)
+		{
+			target.push_back(char(START_SIGN));
+			_wide.startEncoding(target);
+		}
+		else
+		{
+			RangeCoderStream::attachSink(rc, target);
+			start_encoding(&rc, START_SIGN, 0);
+		}
+
+		resetRepeats();
+		_runLength = 0;
+		_afterRun = false;
+		_lastLength = MIN_LENGTH;
+		if (searchModels)
+			writeTokens(start);
+		else
+			parse(bufSize);
+		if (_backend == BINARY_CODER)
+		{
+			_binary.encodeBit(_bitModels.isMatch[_state], 1);
+			_binary.encodeBit(_bitModels.isEnd, 1);
+			_binary.doneEncoding();
+		}
+		else if (_backend == RANS_CODER || _backend == HUFFMAN_CODER)
+		{
+			for (size_t first = 0; first < _blockTokens.size(); first += BLOCK_SIZE)
+			{
+				size_t last = std::min(_blockTokens.size(), first + BLOCK_SIZE);
+				if (_backend == RANS_CODER)
+					writeRansBlock(first, last, target);
+				else
+					writeHuffmanBlock(first, last, target);
+			}
+			RansCoder::writeNumber(target, 0);
+		}
+		else
+		{
+			int ch, syfreq, ltfreq;
+			writeLiteralRun();
+			qsmodel & flags = currentFlagModel();
+			qsgetfreq(&flags, 2, &syfreq, &ltfreq);
+			encodeShift(syfreq, ltfreq, flags.lgtotf);
+			if (_backend == WIDE_RANGE_CODER)
+				_wide.doneEncoding();
+			else
+				done_encoding(&rc);
+		}
+		if (_statistics)
+			++_statistics->flags[2];
+		_buffer = input;
+		bufSize = inputSize;
+	}
+
+	/// <summary>
+	/// Wyszukuje dopasowania od biezacej pozycji bufora do podanej i zapisuje kolejne symbole LZSS.
+	/// </summary>
+	void parse(int end)
+	{
+		while (bufPos < end)
+		{
+			// za krotka koncowka nie moze byc dopasowaniem
+			if (bufPos + MIN_LENGTH > bufSize)
+			{
+				writePair(_buffer[bufPos]);
+				continue;
+			}
+			int maxLength = 0, maxOffset = 0;
+			long hash = getHash(bufPos);
+			auto &positions = myMap[hash];
+			bool seqFound = !positions.empty() && getLongestSequenceLength(positions, maxOffset, maxLength);
+			if (_dictionary)
+				seqFound = getLongestDictionarySequence(hash, maxOffset, maxLength) || seqFound;
+			int repeatIndex, repeatLength;
+			if (usesRepeatOffsets() && getLongestRepeatSequence(repeatIndex, repeatLength)
+				&& (!seqFound || isRepeatBetter(repeatLength, maxOffset, maxLength)))
+				writeRepeatMatch(repeatIndex, repeatLength);
+			else if (seqFound)
+				writeTripple(maxOffset, maxLength);
+			else
+				writePair(_buffer[bufPos]);
+		}
+	}
+
+	/// <summary>
+	/// Szuka najdluzszego dopasowania z jedna z ostatnich odleglosci; przy rownej dlugosci
+	/// wybierana jest nowsza odleglosc.
+	/// </summary>
+	/// <returns><c>true</c> jezeli ktoras z odleglosci daje dopasowanie</returns>
+	bool getLongestRepeatSequence(int & repeatIndex, int & repeatLength)
+	{
+		repeatIndex = -1;
+		repeatLength = 0;
+		for (int i = 0; i < REPEAT_COUNT; ++i)
+		{
+			int offset = static_cast<int>(_repeats[i]);
+			if (offset > bufPos)
+				continue;
+			int currentLength = getSequenceLength(bufPos - offset, offset);
+			if (currentLength > repeatLength && currentLength >= MIN_LENGTH)
+			{
+				repeatLength = currentLength;
+				repeatIndex = i;
+			}
+		}
+		return repeatIndex >= 0;
+	}
+
+	/// <summary>
+	/// Czy dopasowanie z ostatnia odlegloscia jest lepsze od znalezionego zwyklego dopasowania.
+	/// Powtorzona odleglosc nie jest kodowana, wiec moze byc o bajt krotsza, a od dalekiej
+	/// odleglosci zapisywanej dodatkowymi bitami o dwa bajty krotsza.
+	/// </summary>
+	static bool isRepeatBetter(int repeatLength, int maxOffset, int maxLength)
+	{
+		return repeatLength + (maxOffset > MAX_LITTLE_OFFSET ? 2 : 1) > maxLength;
+	}
+
+	/// <summary>
+	/// Dzieli dane sekcji na symbole LZSS bez kodowania, a nastepnie wybiera na nich rodzaj modeli
+	/// dlugosci i parametry modeli. Zebrane symbole koduje pozniej writeTokens.
+	/// </summary>
+	void selectModels(int letterAlphabetSize)
+	{
+		int start = bufPos;
+		_collectTokens = true;
+		_blockTokens.clear();
+		resetRepeats();
+		parse(bufSize);
+		_collectTokens = false;
+
+		Frequencies const * prior = _prior && (int)_prior->letters.size() == letterAlphabetSize ? _prior : nullptr;
+		if (_parameterSearch)
+			_parameters = ModelParameters();
+		if (_lengthContextSearch)
+			searchLengthContexts(prior);
+		if (_parameterSearch)
+		{
+			// parametry wybierane sa na symbolach z poczatku danych
+			size_t sampleTokens = 0;
+			for (int position = start; sampleTokens < _blockTokens.size() && position < start + PARAMETER_SAMPLE_SIZE; ++sampleTokens)
+			{
+				BlockToken const & token = _blockTokens[sampleTokens];
+				position += token.offset == 0 ? 1 : token.value + MIN_LENGTH;
+			}
+			searchParameters(prior, letterAlphabetSize, sampleTokens);
+		}
+	}
+
+	/// <summary>
+	/// Koduje symbole LZSS zebrane przez selectModels; litery czytane sa z bufora od podanej pozycji.
+	/// </summary>
+	void writeTokens(int position)
+	{
+		for (BlockToken const & token : _blockTokens)
+		{
+			if (token.offset == 0)
+			{
+				writeLetterSymbol(position++);
+				continue;
+			}
+			unsigned int length = token.value + MIN_LENGTH;
+			if (token.repeat)
+				writeRepeatSymbols(token.repeat - 1, token.offset, length);
+			else
+				writeMatchSymbols(token.offset, length);
+			_lastLength = length;
+			position += length;
+		}
+		_blockTokens.clear();
+	}
+
+	/// <summary>
+	/// Wlacza konteksty modeli dlugosci, jezeli dlugosci sekcji zajmuja z nimi o wiecej niz bajt maski
+	/// w naglowku mniej bitow niz w modelach wedlug logarytmu odleglosci; przy wyborze parametrow
+	/// oba rodzaje maja domyslne parametry.
+	/// </summary>
+	void searchLengthContexts(Frequencies const * prior)
+	{
+		double bits[2];
+		for (int contexts = 0; contexts < 2; ++contexts)
+		{
+			_lengthContexts = contexts != 0;
+			std::vector<std::pair<int, int>> symbols;
+			int lastLength = MIN_LENGTH;
+			for (BlockToken const & token : _blockTokens)
+			{
+				if (token.offset == 0)
+					continue;
+				symbols.emplace_back(lengthModelIndex(token.offset, lastLength), token.value + MIN_LENGTH);
+				lastLength = token.value + MIN_LENGTH;
+			}
+			bits[contexts] = estimateBits(symbols, LENGTH_MODELS, lengthModelCount(), LENGTH_ALPHABET_SIZE, prior, _parameters.groups[LENGTH_MODELS]);
+		}
+		_lengthContexts = bits[1] + 8 < bits[0];
+	}
+
+	/// <summary>
+	/// Wybiera parametry kazdej grupy modeli, przy ktorych poczatek sekcji zajmuje najmniej bitow.
+	/// Dla kazdej grupy symulowane sa modele ze wszystkimi poprawnymi parametrami na symbolach
+	/// z podanej liczby pierwszych symboli zebranych przez selectModels. Parametry inne niz domyslne
+	/// wybierane sa tylko, jezeli oszczedzaja wiecej bitow, niz zajmuje ich zapis w naglowku.
+	/// </summary>
+	void searchParameters(Frequencies const * prior, int letterAlphabetSize, size_t tokenCount)
+	{
+		// symbole kazdej grupy jako pary: numer modelu w grupie i symbol
+		std::vector<std::pair<int, int>> symbols[MODEL_GROUP_COUNT];
+		int run = 0;
+		int lastLength = MIN_LENGTH;
+		for (size_t i = 0; i < tokenCount; ++i)
+		{
+			BlockToken const & token = _blockTokens[i];
+			// kolejne litery ciagu nie maja wlasnej flagi
+			if (token.offset == 0 && usesLiteralRuns() && run > 0 && run < MAX_RUN_LENGTH)
+			{
+				++run;
+				symbols[LETTER_MODELS].emplace_back(0, token.value);
+				continue;
+			}
+			int flagModelIndex = usesLiteralRuns() && run > 0 && run < MAX_RUN_LENGTH ? 1 : 0;
+			run = token.offset == 0 ? 1 : 0;
+			symbols[FLAG_MODELS].emplace_back(flagModelIndex, token.repeat ? FIRST_REPEAT_FLAG + token.repeat - 1 : token.offset == 0);
+			if (token.offset == 0)
+			{
+				symbols[LETTER_MODELS].emplace_back(0, token.value);
+				continue;
+			}
+			if (!token.repeat)
+				symbols[OFFSET_MODELS].emplace_back(0, std::min<int>(token.offset, MAX_LITTLE_OFFSET + 1));
+			symbols[LENGTH_MODELS].emplace_back(lengthModelIndex(token.offset, lastLength), token.value + MIN_LENGTH);
+			lastLength = token.value + MIN_LENGTH;
+		}
+
+		const int alphabetSizes[MODEL_GROUP_COUNT] = { flagAlphabetSize(), letterAlphabetSize, OFFSET_ALPHABET_SIZE, LENGTH_ALPHABET_SIZE };
+		const int modelCounts[MODEL_GROUP_COUNT] = { 2, 1, 1, lengthModelCount() };
+		double saved = 0;
+		for (int group = 0; group < MODEL_GROUP_COUNT; ++group)
+		{
+			if (symbols[group].empty() || (group == LETTER_MODELS && _literalContexts))
+				continue;
+			ModelGroup modelGroup = static_cast<ModelGroup>(group);
+			const double defaultBits = estimateBits(symbols[group], modelGroup, modelCounts[group], alphabetSizes[group], prior, ModelParameters::DEFAULT);
+			double best = defaultBits;
+			for (int lgTotf = LG_TOTF; lgTotf <= ModelParameters::MAX_LG_TOTF; ++lgTotf)
+			{
+				for (int shift = 0; shift <= ModelParameters::MAX_RESCALE_SHIFT; ++shift)
+				{
+					unsigned char code = ModelParameters::code(lgTotf, shift);
+					if (code == ModelParameters::DEFAULT || !ModelParameters::isValid(code))
+						continue;
+					double bits = estimateBits(symbols[group], modelGroup, modelCounts[group], alphabetSizes[group], prior, code);
+					if (bits < best)
+					{
+						best = bits;
+						_parameters.groups[group] = code;
+					}
+				}
+			}
+			saved += defaultBits - best;
+		}
+		if (saved <= 8 * MODEL_GROUP_COUNT)
+			_parameters = ModelParameters();
+	}
+
+	/// <summary>
+	/// Szacuje liczbe bitow symboli grupy zakodowanych modelami o podanych parametrach,
+	/// symulujac aktualizacje modeli qsmodel.
+	/// </summary>
+	double estimateBits(std::vector<std::pair<int, int>> const & symbols, ModelGroup group, int modelCount, int alphabetSize,
+		Frequencies const * prior, unsigned char code)
+	{
+		const int lgTotf = ModelParameters::lgTotf(code);
+		std::vector<qsmodel> models(modelCount);
+		for (int i = 0; i < modelCount; ++i)
+			initqsmodeltbl(&models[i], alphabetSize, lgTotf, ModelParameters::rescale(code), 0, initArray(prior, group, i, lgTotf), COMPRESS);
+		double bits = 0;
+		for (auto const & symbol : symbols)
+		{
+			int sysfreq, ltfreq;
+			qsmodel & model = models[symbol.first];
+			qsgetfreq(&model, symbol.second, &sysfreq, &ltfreq);
+			bits += lgTotf - std::log2(sysfreq);
+			qsupdate(&model, symbol.second);
+		}
+		for (auto & model : models)
+			deleteqsmodel(&model);
+		return bits;
+	}
+
+	/// <summary>
+	/// Buduje mape pozycji ciagow slownika, jezeli slownik zmienil sie od poprzedniej kompresji.
+	/// </summary>
+	void indexDictionary()
+	{
+		if (_dictionaryIndexed)
+			return;
+		_dictionaryMap.clear();
+		char * input = _buffer;
+		_buffer = const_cast<char *>(_dictionary->data());
+		for (int position = 0; position + MIN_LENGTH <= (int)_dictionary->size(); ++position)
+			_dictionaryMap[getHash(position)].push_back(position);
+		_buffer = input;
+		_dictionaryIndexed = true;
+	}
+
+	/// <summary>
+	/// Zapisuje blok symboli LZSS: liczbe symboli, liczniki modeli i dane kodera rANS.
+	/// </summary>
+	void writeRansBlock(size_t first, size_t last, std::vector<char> & target)
+	{
+		_ransFlags.clear();
+		_ransLetters.clear();
+		_ransOffsets.clear();
+		_ransLengths.clear();
+		for (size_t i = first; i < last; ++i)
+		{
+			BlockToken const & token = _blockTokens[i];
+			_ransFlags.count(token.offset == 0);
+			if (token.offset == 0)
+				_ransLetters.count(token.value);
+			else
+			{
+				_ransOffsets.count(offsetSlot(token.offset - 1));
+				_ransLengths.count(token.value);
+			}
+		}
+		RansCoder::writeNumber(target, static_cast<uint32_t>(last - first));
+		_ransFlags.save(target);
+		_ransLetters.save(target);
+		_ransOffsets.save(target);
+		_ransLengths.save(target);
+
+		std::vector<RansCoder::Symbol> symbols;
+		symbols.reserve(3 * (last - first));
+		for (size_t i = first; i < last; ++i)
+		{
+			BlockToken const & token = _blockTokens[i];
+			symbols.push_back(_ransFlags.symbol(token.offset == 0));
+			if (token.offset == 0)
+			{
+				symbols.push_back(_ransLetters.symbol(token.value));
+				continue;
+			}
+			unsigned int distance = token.offset - 1;
+			int slot = offsetSlot(distance);
+			symbols.push_back(_ransOffsets.symbol(slot));
+			if (slot >= FIRST_FOOTER_SLOT)
+			{
+				int footerBits = (slot >> 1) - 1;
+				unsigned int reduced = distance - ((2 | (slot & 1)) << footerBits);
+				if (footerBits > 8)
+					symbols.push_back(RansCoder::bits(reduced >> 8, footerBits - 8));
+				symbols.push_back(RansCoder::bits(reduced & 0xFF, std::min(footerBits, 8)));
+			}
+			symbols.push_back(_ransLengths.symbol(token.value));
+		}
+		RansCoder::encode(symbols, target);
+	}
+
+	/// <summary>
+	/// Zapisuje blok symboli LZSS: liczbe symboli, dlugosci kodow Huffmana, rozmiar danych i dane.
+	/// </summary>
+	void writeHuffmanBlock(size_t first, size_t last, std::vector<char> & target)
+	{
+		_huffmanSymbols.clear();
+		_huffmanOffsets.clear();
+		for (size_t i = first; i < last; ++i)
+		{
+			BlockToken const & token = _blockTokens[i];
+			if (token.offset == 0)
+				_huffmanSymbols.count(token.value);
+			else
+			{
+				_huffmanSymbols.count((1 << 8) + token.value);
+				_huffmanOffsets.count(offsetSlot(token.offset - 1));
+			}
+		}
+		RansCoder::writeNumber(target, static_cast<uint32_t>(last - first));
+		_huffmanSymbols.save(target);
+		_huffmanOffsets.save(target);
+
+		std::vector<char> data;
+		HuffmanCoder::BitWriter writer(data);
+		for (size_t i = first; i < last; ++i)
+		{
+			BlockToken const & token = _blockTokens[i];
+			int symbol = token.offset == 0 ? token.value : (1 << 8) + token.value;
+			writer.write(_huffmanSymbols.code(symbol), _huffmanSymbols.length(symbol));
+			if (token.offset == 0)
+				continue;
+			unsigned int distance = token.offset - 1;
+			int slot = offsetSlot(distance);
+			writer.write(_huffmanOffsets.code(slot), _huffmanOffsets.length(slot));
+			if (slot >= FIRST_FOOTER_SLOT)
+			{
+				int footerBits = (slot >> 1) - 1;
+				writer.write(distance - ((2 | (slot & 1)) << footerBits), footerBits);
+			}
+		}
+		writer.flush();
+		RansCoder::writeNumber(target, static_cast<uint32_t>(data.size()));
+		target.insert(target.end(), data.begin(), data.end());
+	}
+
+	void initializeModels(int mode, int letterAlphabetSize)
+	{
+		if (_backend == RANS_CODER || _backend == HUFFMAN_CODER)
+			return;
+		Frequencies const * prior = _prior && (int)_prior->letters.size() == letterAlphabetSize ? _prior : nullptr;
+		if (_literalContexts)
+		{
+			if (!_literalModel)
+				_literalModel.reset(new LiteralContextModel());
+			_literalModel->reset(prior ? &prior->letters : nullptr);
+		}
+		if (_backend == BINARY_CODER)
+		{
+			Probability * models = reinterpret_cast<Probability *>(&_bitModels);
+			std::fill(models, models + sizeof(_bitModels) / sizeof(Probability), Probability(BinaryRangeCoder::INITIAL_PROBABILITY));
+			return;
+		}
+		if (_modelsReady && mode == _modelMode && letterAlphabetSize == _modelAlphabetSize && _parameters == _modelParameters
+			&& flagModel.n == flagAlphabetSize() && _modelLengthCount == lengthModelCount())
+		{
+			resetqsmodel(&flagModel, initArray(prior, FLAG_MODELS, 0, flagModel.lgtotf));
+			resetqsmodel(&runFlagModel, initArray(prior, FLAG_MODELS, 1, runFlagModel.lgtotf));
+			resetqsmodel(&letterModel, initArray(prior, LETTER_MODELS, 0, letterModel.lgtotf));
+			resetqsmodel(&offsetModel, initArray(prior, OFFSET_MODELS, 0, offsetModel.lgtotf));
+			resetqsmodel(&runModel, runFrequencies());
+			resetqsmodel(&slotModel, NULL);
+			for (int i = 0; i < LONG_OFFSET_SLOT_COUNT; ++i)
+				resetqsmodel(&footerModel[i], NULL);
+			for (int i = 0; i < _modelLengthCount; i++)
+			{
+				resetqsmodel(&lengthModel[i], initArray(prior, LENGTH_MODELS, i, lengthModel[i].lgtotf));
+			}
+			return;
+		}
+		if (_modelsReady)
+			deleteModels();
+		_modelMode = mode;
+		_modelAlphabetSize = letterAlphabetSize;
+		_modelLengthCount = lengthModelCount();
+		_modelParameters = _parameters;
+		_modelsReady = true;
+		initModel(flagModel, flagAlphabetSize(), prior, FLAG_MODELS, 0, mode);
+		initModel(runFlagModel, flagAlphabetSize(), prior, FLAG_MODELS, 1, mode);
+		initModel(letterModel, letterAlphabetSize, prior, LETTER_MODELS, 0, mode);
+		initModel(offsetModel, OFFSET_ALPHABET_SIZE, prior, OFFSET_MODELS, 0, mode);
+		// zestawy czestosci nie zawieraja dlugosci ciagow liter, a model ma zawsze parametry domyslne
+		initqsmodeltbl(&runModel, MAX_RUN_LENGTH, LG_TOTF, ModelParameters::rescale(ModelParameters::DEFAULT),
+			ceilLog2(MAX_RUN_LENGTH) + 1, runFrequencies(), mode);
+		// przedzialy odleglosci rowniez nie maja zestawow czestosci ani parametrow; na poczatku sekcji
+		// odleglosci rosna razem z pozycja, dlatego model przedzialow przeskalowywany jest najczesciej
+		initqsmodeltbl(&slotModel, LONG_OFFSET_SLOT_COUNT, LG_TOTF, ModelParameters::RESCALE_BASE,
+			ceilLog2(LONG_OFFSET_SLOT_COUNT) + 1, NULL, mode);
+		for (int i = 0; i < LONG_OFFSET_SLOT_COUNT; ++i)
+			initqsmodeltbl(&footerModel[i], 1 << FOOTER_MODEL_BITS, LG_TOTF, ModelParameters::rescale(ModelParameters::DEFAULT),
+				FOOTER_MODEL_BITS + 1, NULL, mode);
+		for (int i = 0; i < _modelLengthCount; i++)
+		{
+			initModel(lengthModel[i], LENGTH_ALPHABET_SIZE, prior, LENGTH_MODELS, i, mode);
+		}
+	}
+
+	/// <summary>
+	/// Inicjalizuje model grupy z jej parametrami. Tablica wyszukiwania dekodera ma okolo dwie pozycje
+	/// na symbol, dzieki czemu qsgetsym rzadko przeszukuje wiecej niz kilka czestosci; jej rozmiar
+	/// nie wplywa na zapisane dane.
+	/// </summary>
+	void initModel(qsmodel & model, int alphabetSize, Frequencies const * prior, ModelGroup group, int index, int mode)
+	{
+		unsigned char code = _parameters.groups[group];
+		int lgTotf = ModelParameters::lgTotf(code);
+		initqsmodeltbl(&model, alphabetSize, lgTotf, ModelParameters::rescale(code), ceilLog2(alphabetSize) + 1,
+			initArray(prior, group, index, lgTotf), mode);
+	}
+
+	/// <summary>
+	/// Poczatkowe czestosci modelu grupy przeskalowane do sumy 1 &lt;&lt; lgTotf albo NULL.
+	/// </summary>
+	int * initArray(Frequencies const * prior, ModelGroup group, int index, int lgTotf)
+	{
+		std::vector<int> const * frequencies;
+		if (group == FLAG_MODELS && (usesRepeatOffsets() || index > 0))
+			frequencies = &flagFrequencies(prior, index > 0);
+		else if (!prior)
+			return NULL;
+		else if (group == LENGTH_MODELS && usesLengthContexts())
+			frequencies = &lengthFrequencies(*prior, index);
+		else
+			frequencies = group == FLAG_MODELS ? &prior->flags
+				: group == LETTER_MODELS ? &prior->letters
+				: group == OFFSET_MODELS ? &prior->offsets
+				: &prior->lengths[index];
+		if (lgTotf == LG_TOTF)
+			return initArray(*frequencies);
+		_scaledPrior.resize(frequencies->size());
+		for (size_t i = 0; i < frequencies->size(); ++i)
+			_scaledPrior[i] = (*frequencies)[i] << (lgTotf - LG_TOTF);
+		return _scaledPrior.data();
+	}
+
+	/// <summary>
+	/// Poczatkowe czestosci flag z flagami powtorzonych odleglosci albo po ciagu liter. Zestawy czestosci
+	/// licza powtorzone odleglosci jako zwykle dopasowania, dlatego zwykle flagi otrzymuja czestosci
+	/// z zestawu albo rowne, zmniejszone tak, aby kazda flaga powtorzenia miala 1/128 sumy czestosci.
+	/// Po ciagu liter czestosc flagi litery przechodzi na flage dopasowania.
+	/// </summary>
+	std::vector<int> const & flagFrequencies(Frequencies const * prior, bool afterRun)
+	{
+		const int total = 1 << LG_TOTF;
+		const int share = usesRepeatOffsets() ? total / 128 : 0;
+		const int rest = total - REPEAT_COUNT * share;
+		_extendedPrior.resize(FLAG_ALPHABET_SIZE);
+		int assigned = 0;
+		for (int i = 0; i < FLAG_ALPHABET_SIZE; ++i)
+		{
+			_extendedPrior[i] = std::max(1, prior ? prior->flags[i] * rest / total : rest / FLAG_ALPHABET_SIZE);
+			assigned += _extendedPrior[i];
+		}
+		*std::max_element(_extendedPrior.begin(), _extendedPrior.end()) += rest - assigned;
+		if (afterRun)
+		{
+			_extendedPrior[0] += _extendedPrior[1] - 1;
+			_extendedPrior[1] = 1;
+		}
+		_extendedPrior.resize(flagAlphabetSize(), share);
+		return _extendedPrior;
+	}
+
+	/// <summary>
+	/// Poczatkowe czestosci modelu dlugosci z kontekstem: srednia czestosci zestawu dla logarytmow
+	/// odleglosci z grupy modelu. Reszta z zaokraglen trafia do najczestszego symbolu.
+	/// </summary>
+	std::vector<int> const & lengthFrequencies(Frequencies const & prior, int index)
+	{
+		const int offsetGroup = index / LENGTH_HISTORY_GROUPS;
+		_extendedPrior.assign(LENGTH_ALPHABET_SIZE, 0);
+		int count = 0;
+		for (int log = 0; log < LENGTH_MODEL_SIZE; ++log)
+		{
+			if (lengthOffsetGroup(log) != offsetGroup)
+				continue;
+			for (int i = 0; i < LENGTH_ALPHABET_SIZE; ++i)
+				_extendedPrior[i] += prior.lengths[log][i];
+			++count;
+		}
+		int assigned = 0;
+		for (int & frequency : _extendedPrior)
+		{
+			frequency /= count;
+			assigned += frequency;
+		}
+		*std::max_element(_extendedPrior.begin(), _extendedPrior.end()) += (1 << LG_TOTF) - assigned;
+		return _extendedPrior;
+	}
+
+	/// <summary>
+	/// Tablica poczatkowych czestosci w postaci wymaganej przez qsmodel, ktory jej nie modyfikuje.
+	/// </summary>
+	static int * initArray(std::vector<int> const & frequencies)
+	{
+		return const_cast<int *>(frequencies.data());
+	}
+
+	long getHash(int x)
+	{
+		return (_buffer[(x)] << 16) | (_buffer[(x)+1] << 8) | (_buffer[(x)+2]);
+	}
+
+	bool getLongestSequenceLength(PositionVector & positions, int & maxOffset, int & maxLength)
+	{
+		maxOffset = 0, maxLength = 0;
+		PositionVector::iterator it = positions.begin();
+		while (it != positions.end())
+		{
+			int position = *it;
+			int offset = bufPos - position;
+			if (offset >= MAX_OFFSET)
+			{
+				it = positions.erase(it);
+				continue;
+			}
+			int currentLength = getSequenceLength(position, offset);
+			if (currentLength > maxLength && currentLength >= MIN_LENGTH)
+			{
+				maxLength = currentLength;
+				maxOffset = offset;
+			}
+			++it;
+		}
+		return maxOffset > 0;
+	}
+
+	/// <summary>
+	/// Szuka w slowniku dopasowania dluzszego od znalezionego w danych. Przy rownej dlugosci
+	/// wybierana jest blizsza pozycja, ktorej odleglosc kodowana jest krocej.
+	/// </summary>
+	/// <returns><c>true</c> jezeli slownik zawiera dluzsze dopasowanie</returns>
+	bool getLongestDictionarySequence(long hash, int & maxOffset, int & maxLength)
+	{
+		auto found = _dictionaryMap.find(hash);
+		if (found == _dictionaryMap.end())
+			return false;
+		bool improved = false;
+		PositionVector const & positions = found->second;
+		for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+		{
+			int offset = bufPos - *it;
+			if (offset >= MAX_OFFSET)
+				break;
+			int currentLength = getSequenceLength(*it, offset);
+			if (currentLength > maxLength && currentLength >= MIN_LENGTH)
+			{
+				maxLength = currentLength;
+				maxOffset = offset;
+				improved = true;
+			}
+		}
+		return improved;
+	}
+
+	/// <summary>
+	/// Dlugosc wspolnego ciagu od pozycji w buforze i od biezacej pozycji, ograniczona tak,
+	/// aby kopiowany ciag nie zachodzil na kopie.
+	/// </summary>
+	int getSequenceLength(int position, int offset)
+	{
+		int currentLength = 0;
+		int currentPosition = bufPos;
+		int myPosition = position;
+		while (currentPosition < bufSize
+			&& _buffer[currentPosition] == _buffer[myPosition]
+			&& currentLength < MAX_LENGTH - 1
+			&& currentLength < offset - 1)
+		{
+			++currentLength;
+			++currentPosition;
+			++myPosition;
+		}
+		return currentLength;
+	}
+
+	void writeTripple(unsigned int offset, unsigned int length)
+	{
+		int zero = 0;
+		if (_backend == BINARY_CODER)
+			writeBinaryMatch(offset, length);
+		else if (_collectTokens || _backend == RANS_CODER || _backend == HUFFMAN_CODER)
+		{
+			BlockToken token = { static_cast<uint16_t>(offset), static_cast<uint8_t>(length - MIN_LENGTH), 0 };
+			_blockTokens.push_back(token);
+		}
+		else
+			writeMatchSymbols(offset, length);
+		_lastLength = length;
+		if (usesRepeatOffsets())
+			pushRepeat(offset);
+		int log = ceilLog2(offset);
+		if (_statistics)
+		{
+			++_statistics->flags[zero];
+			++_statistics->offsets[std::min<unsigned int>(offset, MAX_LITTLE_OFFSET + 1)];
+			++_statistics->lengths[log][length];
+		}
+		for (unsigned int i = 0; i < length; i++)
+		{
+			addNewHash();
+		}
+	}
+
+	/// <summary>
+	/// Zapisuje dopasowanie z jedna z ostatnich odleglosci: flage z numerem odleglosci i dlugosc.
+	/// Liczniki zestawu czestosci zliczaja je jak zwykle dopasowania.
+	/// </summary>
+	void writeRepeatMatch(int repeatIndex, unsigned int length)
+	{
+		unsigned int offset = useRepeat(repeatIndex);
+		if (_collectTokens)
+		{
+			BlockToken token = { static_cast<uint16_t>(offset), static_cast<uint8_t>(length - MIN_LENGTH), static_cast<uint8_t>(repeatIndex + 1) };
+			_blockTokens.push_back(token);
+		}
+		else
+			writeRepeatSymbols(repeatIndex, offset, length);
+		_lastLength = length;
+		if (_statistics)
+		{
+			++_statistics->flags[0];
+			++_statistics->offsets[std::min<unsigned int>(offset, MAX_LITTLE_OFFSET + 1)];
+			++_statistics->lengths[ceilLog2(offset)][length];
+		}
+		for (unsigned int i = 0; i < length; i++)
+		{
+			addNewHash();
+		}
+	}
+
+	bool usesLiteralRuns() const
+	{
+		return _literalRuns && (_backend == RANGE_CODER || _backend == WIDE_RANGE_CODER);
+	}
+
+	bool usesRepeatOffsets() const
+	{
+		return _repeatOffsets && (_backend == RANGE_CODER || _backend == WIDE_RANGE_CODER);
+	}
+
+	int flagAlphabetSize() const
+	{
+		return usesRepeatOffsets() ? REPEAT_FLAG_ALPHABET_SIZE : FLAG_ALPHABET_SIZE;
+	}
+
+	bool usesOffsetSlots() const
+	{
+		return _offsetSlots && (_backend == RANGE_CODER || _backend == WIDE_RANGE_CODER);
+	}
+
+	bool usesLengthContexts() const
+	{
+		return _lengthContexts && (_backend == RANGE_CODER || _backend == WIDE_RANGE_CODER);
+	}
+
+	int lengthModelCount() const
+	{
+		return usesLengthContexts() ? LENGTH_CONTEXT_MODELS : LENGTH_MODEL_SIZE;
+	}
+
+	/// <summary>
+	/// Numer modelu dlugosci dopasowania: logarytm odleglosci albo, przy kontekstach dlugosci,
+	/// grupa logarytmu odleglosci i grupa dlugosci poprzedniego dopasowania.
+	/// </summary>
+	int lengthModelIndex(unsigned int offset, int lastLength)
+	{
+		int log = ceilLog2(offset);
+		if (!usesLengthContexts())
+			return log;
+		return lengthOffsetGroup(log) * LENGTH_HISTORY_GROUPS + lengthHistoryGroup(lastLength);
+	}
+
+	static int lengthOffsetGroup(int log)
+	{
+		return log <= 3 ? 0 : log <= 7 ? 1 : 2;
+	}
+
+	static int lengthHistoryGroup(int length)
+	{
+		return length <= 3 ? 0 : length <= 5 ? 1 : length <= 10 ? 2 : 3;
+	}
+
+	/// <summary>
+	/// Ustawia poczatkowe ostatnie odleglosci; odleglosci 1-4 nie daja dopasowan, dopoki nie zostana zastapione.
 	/// </summary>
-	/// <param name="source">Zrodlo znakow.</param>
-	/// <param name="target">Sciezka do pliku wyjsciowego.</param>
-	/// <param name="letterAlphabetSize">Rozmiar alfabetu wejsciowego.</param>
-	void encode(std::string const & source, std::string const & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	void resetRepeats()
 	{
-		toBuffer(source);
-		encode(target, letterAlphabetSize);
-		delete[] _buffer;
+		for (int i = 0; i < REPEAT_COUNT; ++i)
+			_repeats[i] = i + 1;
 	}
 
 	/// <summary>
-	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// Dodaje odleglosc zwyklego dopasowania jako najnowsza; koder nie zapisuje zwyklym dopasowaniem
+	/// zadnej z ostatnich odleglosci, wiec odleglosci pozostaja rozne.
 	/// </summary>
-	/// <param name="source">Zrodlo znakow.</param>
-	/// <param name="target">Sciezka do pliku wyjsciowego.</param>
-	/// <param name="letterAlphabetSize">Rozmiar alfabetu wejsciowego.</param>
-	void encode(std::vector<int> const & source, std::string const & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	void pushRepeat(unsigned int offset)
 	{
-		toBuffer(source);
-		encode(target, letterAlphabetSize);
-		delete[] _buffer;
+		for (int i = REPEAT_COUNT - 1; i > 0; --i)
+			_repeats[i] = _repeats[i - 1];
+		_repeats[0] = offset;
 	}
 
 	/// <summary>
-	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
+	/// Przenosi odleglosc o podanym numerze na poczatek i ja zwraca.
 	/// </summary>
-	/// <param name="source">Zrodlo znakow.</param>
-	/// <param name="target">Sciezka do pliku wyjsciowego.</param>
-	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
-	void encode(std::vector<std::string> const & source, std::string const & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	unsigned int useRepeat(int repeatIndex)
 	{
-		toBuffer(source);
-		encode(target, letterAlphabetSize);
-		delete[] _buffer;
+		unsigned int offset = _repeats[repeatIndex];
+		for (int i = repeatIndex; i > 0; --i)
+			_repeats[i] = _repeats[i - 1];
+		_repeats[0] = offset;
+		return offset;
 	}
 
-	/// <summary>
-	/// Kompresuje zrodlo znakow do pliku wyjsciowego.
-	/// </summary>
-	/// <param name="source">Zrodlo znakow.</param>
-	/// <param name="target">Sciezka do pliku wyjsciowego.</param>
-	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
-	void encode(std::vector<char> const & source, std::string const & target, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	void writeOffset(unsigned int offset)
 	{
-		toBuffer(source);
-		encode(target, letterAlphabetSize);
+		int sysfreq, ltfreq;
+		if (offset <= MAX_LITTLE_OFFSET)
+		{
+			// zwykly zapis offsetu, taki sam jak na lab 01
+			saveSymbol(offsetModel, offset, sysfreq, ltfreq);
+		}
+		else if (usesOffsetSlots())
+		{
+			// symbol duzego offsetu, numer przedzialu, modelowane najstarsze bity w przedziale i pozostale bity wprost
+			unsigned int distance = offset - 1;
+			int slot = offsetSlot(distance);
+			saveSymbol(offsetModel, MAX_LITTLE_OFFSET + 1, sysfreq, ltfreq);
+			saveSymbol(slotModel, slot - FIRST_LONG_OFFSET_SLOT, sysfreq, ltfreq);
+			int footerBits = (slot >> 1) - 1;
+			int directBits = footerBits - FOOTER_MODEL_BITS;
+			unsigned int footer = distance - ((2 | (slot & 1)) << footerBits);
+			saveSymbol(footerModel[slot - FIRST_LONG_OFFSET_SLOT], footer >> directBits, sysfreq, ltfreq);
+			encodeNBits(footer & ((1 << directBits) - 1), directBits);
+		}
+		else
+		{
+			// zapis duzego offsetu
+			int longOffsetSymbol = 251;
+			unsigned int newOffset = offset - longOffsetSymbol;
+			qsgetfreq(&offsetModel, longOffsetSymbol, &sysfreq, &ltfreq);
+			encodeShift(sysfreq, ltfreq, offsetModel.lgtotf);
+			encodeNBits(newOffset, MAX_OFFSET_BITS);
+			qsupdate(&offsetModel, longOffsetSymbol);
+		}
 	}
 
-	/// <summary>
-	/// Dekompresuje plik zrodlowy do ciagu znakow.
-	/// </summary>
-	/// <param name="source">Sciezka do pliku wejsciowego.</param>
-	/// <param name="pos">Pozycja od ktorej rozpoczac dekompresje.</param>
-	/// <param name="letterAlphabetSize">Rozmiar alfabetu.</param>
-	/// <returns>Zdekompresowany ciag znakow</returns>
-	std::string decode(std::string const & source, int & pos, int letterAlphabetSize = LETTER_ALPHABET_SIZE)
+	void writeBinaryMatch(unsigned int offset, unsigned int length)
 	{
-		auto in = freopen(source.c_str(), "rb", stdin);
-		fseek(in, pos, SEEK_SET);
-		std::string output;
-		int currentPosition = 0, ch, sysfreq, ltfreq;
-		initializeModels(DECOMPRESS, letterAlphabetSize);
-		// rozpoczecie dekompresji
-		start_decoding(&rc);
-		int symbol;
-		while (true)
+		_binary.encodeBit(_bitModels.isMatch[_state], 1);
+		_binary.encodeBit(_bitModels.isEnd, 0);
+		// odleglosci liczone od zera jak w LZMA
+		unsigned int distance = offset - 1;
+		int slot = offsetSlot(distance);
+		_binary.encodeTree(_bitModels.offsetSlots, OFFSET_SLOT_BITS, slot);
+		if (slot >= FIRST_FOOTER_SLOT)
 		{
-			ltfreq = decode_culshift(&rc, LG_TOTF);
-			// odczytanie flagi
-			symbol = qsgetsym(&flagModel, ltfreq);
-			if (symbol == 2)
-				// koniec pliku
-				break;
-			loadSymbol(flagModel, symbol, sysfreq, ltfreq);
-			// litera
-			if (symbol == 1)
+			int footerBits = (slot >> 1) - 1;
+			unsigned int reduced = distance - ((2 | (slot & 1)) << footerBits);
+			if (slot < FIRST_DIRECT_SLOT)
+				_binary.encodeReverseTree(_bitModels.offsetFooters[slot], footerBits, reduced);
+			else
 			{
-				ltfreq = decode_culshift(&rc, LG_TOTF);
-				symbol = qsgetsym(&letterModel, ltfreq);
-				if (symbol == EOF)
-					break;
-				loadSymbol(letterModel, symbol, sysfreq, ltfreq);
-				output += symbol;
+				_binary.encodeDirectBits(reduced >> ALIGN_BITS, footerBits - ALIGN_BITS);
+				_binary.encodeReverseTree(_bitModels.offsetAlign, ALIGN_BITS, reduced & ((1 << ALIGN_BITS) - 1));
 			}
-			else if (symbol == 0)
+		}
+		unsigned int lengthIndex = length - MIN_LENGTH;
+		int context = lengthContext(slot);
+		const unsigned int lowCount = 1 << LENGTH_LOW_BITS;
+		if (lengthIndex < lowCount)
+		{
+			_binary.encodeBit(_bitModels.lengthChoice[context], 0);
+			_binary.encodeTree(_bitModels.lengthLow[context], LENGTH_LOW_BITS, lengthIndex);
+		}
+		else if (lengthIndex < 2 * lowCount)
+		{
+			_binary.encodeBit(_bitModels.lengthChoice[context], 1);
+			_binary.encodeBit(_bitModels.lengthChoice2[context], 0);
+			_binary.encodeTree(_bitModels.lengthMid[context], LENGTH_LOW_BITS, lengthIndex - lowCount);
+		}
+		else
+		{
+			_binary.encodeBit(_bitModels.lengthChoice[context], 1);
+			_binary.encodeBit(_bitModels.lengthChoice2[context], 1);
+			_binary.encodeTree(_bitModels.lengthHigh, LENGTH_HIGH_BITS, lengthIndex - 2 * lowCount);
+		}
+		_state = nextState(_state, true);
+	}
+
+	unsigned int decodeBinaryOffset(int & slot)
+	{
+		slot = static_cast<int>(_binary.decodeTree(_bitModels.offsetSlots, OFFSET_SLOT_BITS));
+		unsigned int distance = slot;
+		if (slot >= FIRST_FOOTER_SLOT)
+		{
+			int footerBits = (slot >> 1) - 1;
+			distance = (2 | (slot & 1)) << footerBits;
+			if (slot < FIRST_DIRECT_SLOT)
+				distance += _binary.decodeReverseTree(_bitModels.offsetFooters[slot], footerBits);
+			else
 			{
-				ltfreq = decode_culshift(&rc, LG_TOTF);
-				// offset
-				unsigned char offset = qsgetsym(&offsetModel, ltfreq);
-				loadSymbol(offsetModel, offset, sysfreq, ltfreq);
-				unsigned short newOffset = offset;
-				if (newOffset > MAX_LITTLE_OFFSET)
-				{
-					newOffset += decodeNBits(&rc, MAX_OFFSET_BITS);
-				}
-				ltfreq = decode_culshift(&rc, LG_TOTF);
-				int log = ceilLog2(newOffset);
-				// dlugosc
-				unsigned char length = qsgetsym(&lengthModel[log], ltfreq);
-				loadSymbol(lengthModel[log], length, sysfreq, ltfreq);
-				int curPosition = output.length();
-				int position = curPosition - newOffset;
-				std::string seqToCopy = output.substr(position, length);
-				output += seqToCopy;
+				distance += _binary.decodeDirectBits(footerBits - ALIGN_BITS) << ALIGN_BITS;
+				distance += _binary.decodeReverseTree(_bitModels.offsetAlign, ALIGN_BITS);
 			}
 		}
-		done_decoding(&rc);
-		deleteModels();
-		pos = ftell(in);
-		fclose(in);
-		return output;
+		return distance + 1;
+	}
+
+	unsigned int decodeBinaryLength(int slot)
+	{
+		int context = lengthContext(slot);
+		const unsigned int lowCount = 1 << LENGTH_LOW_BITS;
+		unsigned int lengthIndex;
+		if (!_binary.decodeBit(_bitModels.lengthChoice[context]))
+			lengthIndex = _binary.decodeTree(_bitModels.lengthLow[context], LENGTH_LOW_BITS);
+		else if (!_binary.decodeBit(_bitModels.lengthChoice2[context]))
+			lengthIndex = lowCount + _binary.decodeTree(_bitModels.lengthMid[context], LENGTH_LOW_BITS);
+		else
+			lengthIndex = 2 * lowCount + _binary.decodeTree(_bitModels.lengthHigh, LENGTH_HIGH_BITS);
+		return lengthIndex + MIN_LENGTH;
 	}
 
 	/// <summary>
-	/// Ustawia wskaznik pozycji na kolejne sekcje range codera
+	/// Numer przedzialu odleglosci: dwa najstarsze bity odleglosci i jej dlugosc w bitach.
 	/// </summary>
-	/// <param name="file">Plik wejsciowy.</param>
-	/// <param name="source">Sciezka do pliku.</param>
-	/// <param name="pos">Pozycja w pliku, zostaje zmieniona.</param>
-	/// <param name="endSign">Znak rozpoczynajacy blok range codera.</param>
-	void changePositionForRangeCoder(std::ifstream & file, std::string const & source, int & pos)
-	{
-		file.open(source, std::ios::binary | std::ios::app);
-		file.seekg(std::ios_base::beg);
-		file.seekg(pos);
-		char a;
-		std::streampos lastPos;
-		while (true)
-		{
-			lastPos = file.tellg();
-			file.read(&a, sizeof(char));
-			if (a == START_SIGN)
-				break;
-		}
-		file.close();
-		pos = lastPos;
+	static int offsetSlot(unsigned int distance)
+	{
+		if (distance < FIRST_FOOTER_SLOT)
+			return distance;
+		int bits = 0;
+		while (distance >> (bits + 1))
+			++bits;
+		return 2 * bits + (distance >> (bits - 1) & 1);
 	}
 
-protected:
-
-	void toBuffer(std::vector<char> const & source)
+	static int lengthContext(int slot)
 	{
-		bufSize = source.size();
-		_buffer = (char*)source.data();
+		return std::min(slot / 8, LENGTH_CONTEXT_COUNT - 1);
 	}
 
-	void toBuffer(std::string const & source)
+	static int nextState(int state, bool match)
 	{
-		bufSize = source.size();
-		_buffer = new char[bufSize + 1];
-		for (int i = 0; i < bufSize; ++i)
-			_buffer[i] = source[i];
-		_buffer[bufSize] = '\0';
+		return (state << 1 | (match ? 1 : 0)) & (STATE_COUNT - 1);
 	}
 
-	void toBuffer(std::vector<int> const & source)
+	void writePair(unsigned char letter)
 	{
-		bufSize = 0;
-		std::vector<std::string> words;
-		for (std::vector<int>::const_iterator numberIt = source.cbegin(); numberIt != source.cend(); ++numberIt)
+		int one = 1;
+		unsigned char previous = bufPos > 0 ? _buffer[bufPos - 1] : 0;
+		unsigned char beforePrevious = bufPos > 1 ? _buffer[bufPos - 2] : 0;
+		if (_backend == BINARY_CODER)
 		{
-			std::string number = std::to_string(*numberIt);
-			words.push_back(number);
-			bufSize += number.size();
-			bufSize += 1;
+			_binary.encodeBit(_bitModels.isMatch[_state], 0);
+			if (_literalContexts)
+				_literalModel->encode(_binary, letter, previous, beforePrevious);
+			else
+				_binary.encodeTree(_bitModels.literals[previous >> (8 - LITERAL_CONTEXT_BITS)], 8, letter);
+			_state = nextState(_state, false);
 		}
-		_buffer = new char[bufSize + 1];
-		int index = 0;
-		for (std::vector<std::string>::const_iterator wordIt = words.cbegin(); wordIt != words.cend(); ++wordIt)
+		else if (_collectTokens || _backend == RANS_CODER || _backend == HUFFMAN_CODER)
 		{
-			for (std::string::const_iterator letterIt = wordIt->cbegin(); letterIt != wordIt->cend(); ++letterIt, ++index)
-			{
-				_buffer[index] = *letterIt;
-			}
-			_buffer[index++] = ' ';
+			BlockToken token = { 0, letter, 0 };
+			_blockTokens.push_back(token);
 		}
-		_buffer[bufSize] = '\0';
+		else
+			writeLetterSymbol(bufPos);
+		if (_statistics)
+		{
+			if (!usesLiteralRuns())
+				++_statistics->flags[one];
+			++_statistics->letters[letter];
+		}
+		addNewHash();
 	}
 
-	void toBuffer(std::vector<std::string> const & source)
+	/// <summary>
+	/// Koduje modelami qsmodel litere z podanej pozycji bufora albo dolacza ja do ciagu liter.
+	/// </summary>
+	void writeLetterSymbol(int position)
 	{
-		bufSize = 0;
-		for (std::vector<std::string>::const_iterator it = source.cbegin(); it != source.cend(); ++it)
+		int sysfreq, ltfreq;
+		if (usesLiteralRuns())
 		{
-			bufSize += it->size();
-			bufSize += 1;
+			// litera dolaczana do ciagu zapisywanego przed kolejnym dopasowaniem
+			if (_runLength == 0)
+				_runStart = position;
+			if (++_runLength == MAX_RUN_LENGTH)
+				writeLiteralRun();
 		}
-		_buffer = new char[bufSize + 1];
-		int index = 0;
-		for (std::vector<std::string>::const_iterator wordIt = source.cbegin(); wordIt != source.cend(); ++wordIt)
+		else
 		{
-			for (std::string::const_iterator letterIt = wordIt->cbegin(); letterIt != wordIt->cend(); ++letterIt, ++index)
-			{
-				_buffer[index] = *letterIt;
-			}
-			_buffer[index++] = ' ';
+			// zapis flagi
+			saveSymbol(flagModel, 1, sysfreq, ltfreq);
+			writeLetter(position);
 		}
-		_buffer[bufSize] = '\0';
 	}
 
-	void encode(std::string const & target, int letterAlphabetSize)
+	/// <summary>
+	/// Koduje modelami qsmodel flage, odleglosc i dlugosc dopasowania.
+	/// </summary>
+	void writeMatchSymbols(unsigned int offset, unsigned int length)
 	{
-		myMap.clear();
-		bufPos = 0;
-		auto out = freopen(target.c_str(), "ab", stdout);
-		initializeModels(COMPRESS, letterAlphabetSize);
-		start_encoding(&rc, START_SIGN, 0);
+		int sysfreq, ltfreq;
+		writeLiteralRun();
+		// zapis zera
+		saveFlag(0);
+		writeOffset(offset);
+		// zapis dlugosci slowa
+		saveSymbol(lengthModel[lengthModelIndex(offset, _lastLength)], length, sysfreq, ltfreq);
+	}
 
-		while (bufPos < bufSize)
-		{
-			int maxLength, maxOffset;
-			long hash = getHash(bufPos);
-			auto &positions = myMap[hash];
-			if (!positions.empty())
-			{
-				bool seqFound = getLongestSequenceLength(positions, maxOffset, maxLength);
-				if (seqFound)
-				{
-					std::string substr;
-					for (int i = bufPos - maxOffset; i < bufPos - maxOffset + maxLength + 1; ++i)
-					{
-						substr += _buffer[i];
-					}
-					writeTripple(maxOffset, maxLength);
-				}
-				else
-				{
-					writePair(_buffer[bufPos]);
-				}
-			}
-			else
-			{
-				writePair(_buffer[bufPos]);
-			}
-		}
-		int ch, syfreq, ltfreq;
-		qsgetfreq(&flagModel, 2, &syfreq, &ltfreq);
-		encode_shift(&rc, syfreq, ltfreq, LG_TOTF);
-		done_encoding(&rc);
-		deleteModels();
-		fclose(out);
+	/// <summary>
+	/// Koduje modelami qsmodel flage z numerem powtorzonej odleglosci i dlugosc dopasowania.
+	/// </summary>
+	void writeRepeatSymbols(int repeatIndex, unsigned int offset, unsigned int length)
+	{
+		int sysfreq, ltfreq;
+		writeLiteralRun();
+		saveFlag(FIRST_REPEAT_FLAG + repeatIndex);
+		saveSymbol(lengthModel[lengthModelIndex(offset, _lastLength)], length, sysfreq, ltfreq);
 	}
 
-	void initializeModels(int mode, int letterAlphabetSize)
+	/// <summary>
+	/// Zapisuje oczekujacy ciag liter: flage litery, dlugosc ciagu i litery.
+	/// </summary>
+	void writeLiteralRun()
+	{
+		if (_runLength == 0)
+			return;
+		int sysfreq, ltfreq;
+		saveFlag(1);
+		saveSymbol(runModel, _runLength - 1, sysfreq, ltfreq);
+		for (int i = 0; i < _runLength; ++i)
+			writeLetter(_runStart + i);
+		if (_statistics)
+			++_statistics->flags[1];
+		_afterRun = _runLength < MAX_RUN_LENGTH;
+		_runLength = 0;
+	}
+
+	/// <summary>
+	/// Poczatkowe czestosci dlugosci ciagow liter, ktorych nie zawieraja zestawy czestosci: dlugosc k
+	/// otrzymuje czesc 1 / (k * (k + 1)) sumy, bo krotkie ciagi miedzy dopasowaniami przewazaja.
+	/// </summary>
+	int * runFrequencies()
 	{
-		initqsmodel(&flagModel, FLAG_ALPHABET_SIZE, LG_TOTF, RESCALE, NULL, mode);
-		initqsmodel(&letterModel, letterAlphabetSize, LG_TOTF, RESCALE, NULL, mode);
-		initqsmodel(&offsetModel, OFFSET_ALPHABET_SIZE, LG_TOTF, RESCALE, NULL, mode);
-		for (int i = 0; i < LENGTH_MODEL_SIZE; i++)
+		const int total = 1 << LG_TOTF;
+		_runFrequencies.resize(MAX_RUN_LENGTH);
+		int assigned = 0;
+		for (int i = 0; i < MAX_RUN_LENGTH; ++i)
 		{
-			initqsmodel(&lengthModel[i], LENGTH_ALPHABET_SIZE, LG_TOTF, RESCALE, NULL, mode);
+			_runFrequencies[i] = std::max(1, total / ((i + 1) * (i + 2)));
+			assigned += _runFrequencies[i];
 		}
+		_runFrequencies[0] += total - assigned;
+		return _runFrequencies.data();
 	}
 
-	long getHash(int x)
+	/// <summary>
+	/// Zapisuje flage modelem zaleznym od tego, czy poprzedzil ja ciag liter.
+	/// </summary>
+	void saveFlag(int flag)
 	{
-		return (_buffer[(x)] << 16) | (_buffer[(x)+1] << 8) | (_buffer[(x)+2]);
+		int sysfreq, ltfreq;
+		saveSymbol(currentFlagModel(), flag, sysfreq, ltfreq);
+		_afterRun = false;
 	}
 
-	bool getLongestSequenceLength(PositionVector & positions, int & maxOffset, int & maxLength)
+	qsmodel & currentFlagModel()
 	{
-		maxOffset = 0, maxLength = 0;
-		PositionVector::iterator it = positions.begin();
-		while (it != positions.end())
-		{
-			int position = *it;
-			int offset = bufPos - position;
-			if (offset >= MAX_OFFSET)
-			{
-				it = positions.erase(it);
-				continue;
-			}
-			int currentLength = 0;
-			int currentPosition = bufPos + currentLength;
-			int myPosition = position + currentLength;
-			while (_buffer[currentPosition] == _buffer[myPosition]
-				&& currentLength < MAX_LENGTH - 1
-				&& currentLength < offset - 1)
-			{
-				++currentLength;
-				++currentPosition;
-				++myPosition;
-			}
-			if (currentLength > maxLength && currentLength >= MIN_LENGTH)
-			{
-				maxLength = currentLength;
-				maxOffset = bufPos - myPosition + currentLength;
-			}
-			++it;
-		}
-		return maxOffset > 0;
+		return _afterRun ? runFlagModel : flagModel;
 	}
 
-	void writeTripple(unsigned int offset, unsigned int length)
+	/// <summary>
+	/// Zapisuje litere z podanej pozycji bufora modelem liter albo modelem kontekstowym.
+	/// </summary>
+	void writeLetter(int position)
 	{
 		int sysfreq, ltfreq;
-		int zero = 0;
-		// zapis zera
-		saveSymbol(flagModel, zero, sysfreq, ltfreq);
-		if (offset <= MAX_LITTLE_OFFSET)
+		unsigned char letter = _buffer[position];
+		if (_literalContexts)
 		{
-			// zwykly zapis offsetu, taki sam jak na lab 01
-			saveSymbol(offsetModel, offset, sysfreq, ltfreq);
+			unsigned char previous = position > 0 ? _buffer[position - 1] : 0;
+			unsigned char beforePrevious = position > 1 ? _buffer[position - 2] : 0;
+			ShiftCoderBits bits = { *this };
+			_literalModel->encode(bits, letter, previous, beforePrevious);
 		}
 		else
-		{
-			// zapis duzego offsetu
-			int longOffsetSymbol = 251;
-			unsigned int newOffset = offset - longOffsetSymbol;
-			qsgetfreq(&offsetModel, longOffsetSymbol, &sysfreq, &ltfreq);
-			encode_shift(&rc, sysfreq, ltfreq, LG_TOTF);
-			encodeNBits(&rc, newOffset, MAX_OFFSET_BITS);
-			qsupdate(&offsetModel, longOffsetSymbol);
-		}
-		// zapis dlugosci slowa
-		int log = ceilLog2(offset);
-		saveSymbol(lengthModel[log], length, sysfreq, ltfreq);
-		for (int i = 0; i < length; i++)
-		{
-			addNewHash();
-		}
-	}
-
-	void writePair(unsigned char letter)
-	{
-		int ch, sysfreq, ltfreq;
-		int one = 1;
-		// zapis flagi
-		saveSymbol(flagModel, one, sysfreq, ltfreq);
-		// zapis litery
-		saveSymbol(letterModel, letter, sysfreq, ltfreq);
-		addNewHash();
+			saveSymbol(letterModel, letter, sysfreq, ltfreq);
 	}
 
 	void saveSymbol(qsmodel & model, int symbol, int & sysfreq, int & ltfreq)
 	{
 		qsgetfreq(&model, symbol, &sysfreq, &ltfreq);
-		encode_shift(&rc, sysfreq, ltfreq, LG_TOTF);
+		encodeShift(sysfreq, ltfreq, model.lgtotf);
 		qsupdate(&model, symbol);
 	}
 
 	void loadSymbol(qsmodel & model, int symbol, int & sysfreq, int & ltfreq)
 	{
 		qsgetfreq(&model, symbol, &sysfreq, &ltfreq);
-		decode_update(&rc, sysfreq, ltfreq, 1 << LG_TOTF);
+		decodeUpdate(sysfreq, ltfreq, model.lgtotf);
 		qsupdate(&model, symbol);
 	}
 
+	/// <summary>
+	/// Koduje przedzial symbolu koderem zakresowym sekcji: z rangecod albo WideRangeCoder.
+	/// </summary>
+	void encodeShift(freq sysfreq, freq ltfreq, int shift)
+	{
+		if (_backend == WIDE_RANGE_CODER)
+			_wide.encodeShift(sysfreq, ltfreq, shift);
+		else
+			encode_shift(&rc, sysfreq, ltfreq, shift);
+	}
+
+	freq decodeShift(int shift)
+	{
+		if (_backend == WIDE_RANGE_CODER)
+			return _wide.decodeShift(shift);
+		return decode_culshift(&rc, shift);
+	}
+
+	void decodeUpdate(freq sysfreq, freq ltfreq, int shift)
+	{
+		if (_backend == WIDE_RANGE_CODER)
+			_wide.decodeUpdate(sysfreq, ltfreq, shift);
+		else
+			decode_update_shift(&rc, sysfreq, ltfreq, shift);
+	}
+
 	void addNewHash()
 	{
-		long hash = getHash(bufPos);
-		auto &positions = myMap[hash];
-		positions.push_back(bufPos);
+		if (bufPos + MIN_LENGTH <= bufSize)
+		{
+			long hash = getHash(bufPos);
+			auto &positions = myMap[hash];
+			positions.push_back(bufPos);
+		}
 		++bufPos;
 	}
 
 	void deleteModels()
 	{
 		deleteqsmodel(&flagModel);
+		deleteqsmodel(&runFlagModel);
 		deleteqsmodel(&letterModel);
 		deleteqsmodel(&offsetModel);
-		for (int i = 0; i < LENGTH_MODEL_SIZE; ++i)
+		deleteqsmodel(&runModel);
+		deleteqsmodel(&slotModel);
+		for (int i = 0; i < LONG_OFFSET_SLOT_COUNT; ++i)
+			deleteqsmodel(&footerModel[i]);
+		for (int i = 0; i < _modelLengthCount; ++i)
 		{
 			deleteqsmodel(&lengthModel[i]);
 		}
@@ -430,16 +2261,36 @@ protected:
 		return result;
 	}
 
-	void encodeNBits(rangecoder * rc, int b, int n)
+	void encodeNBits(int b, int n)
 	{
-		encode_shift(rc, (freq)1, (freq)b, (freq)n);
+		encodeShift((freq)1, (freq)b, n);
 	}
 
-	unsigned short decodeNBits(rangecoder * rc, int n)
+	unsigned short decodeNBits(int n)
 	{
 		unsigned short tmp;
-		tmp = decode_culshift(rc, n);
-		decode_update_shift(rc, 1, tmp, n);
+		tmp = decodeShift(n);
+		decodeUpdate(1, tmp, n);
 		return tmp;
 	}
+
+	/// <summary>
+	/// Odczytuje przedzial i bity dlugiej odleglosci zapisane przez writeOffset po symbolu 251 i zwraca odleglosc.
+	/// </summary>
+	unsigned short decodeLongOffset()
+	{
+		int sysfreq, ltfreq;
+		ltfreq = decodeShift(slotModel.lgtotf);
+		int slot = qsgetsym(&slotModel, ltfreq);
+		loadSymbol(slotModel, slot, sysfreq, ltfreq);
+		slot += FIRST_LONG_OFFSET_SLOT;
+		int footerBits = (slot >> 1) - 1;
+		int directBits = footerBits - FOOTER_MODEL_BITS;
+		qsmodel & model = footerModel[slot - FIRST_LONG_OFFSET_SLOT];
+		ltfreq = decodeShift(model.lgtotf);
+		int high = qsgetsym(&model, ltfreq);
+		loadSymbol(model, high, sysfreq, ltfreq);
+		unsigned int footer = high << directBits | decodeNBits(directBits);
+		return static_cast<unsigned short>(((2 | (slot & 1)) << footerBits) + footer + 1);
+	}
 };
\ No newline at end of file
@@ -1,21 +1,151 @@
 #include <iostream>
+#include <cstring>
 #include "CompresorXml.h"
-#include "port.h"
-#include "qsmodel.h"
-#include "rangecod.h"
-#include <io.h>
-#include <fcntl.h>
+#include "BatchCompressor.h"
+#include "CompressionServer.h"
+#include "LzDictionary.h"
+#include "PriorSet.h"
 
-int main()
+/// <summary>
+/// Wypisuje sposob uzycia programu.
+/// </summary>
+static int usage()
 {
-#ifndef unix
-	_setmode(_fileno(stdin), O_BINARY);
-	_setmode(_fileno(stdout), O_BINARY);
-#endif
+	std::cout << "Uzycie: KomprersorXML (-c | -d) [-j watki] [-o katalog] [-p czestosci] [-x slownik] [-k koder] [-q modele] wejscie..." << std::endl
+		<< "       KomprersorXML -s gniazdo [-j watki] [-p czestosci] [-x slownik] [-k koder] [-q modele]" << std::endl
+		<< "       KomprersorXML -t czestosci id nazwa [-j watki] [-x slownik] wejscie..." << std::endl
+		<< "       KomprersorXML -T slownik id nazwa [-j watki] wejscie..." << std::endl
+		<< "  -c          kompresja plikow .xml do .xml.bin" << std::endl
+		<< "  -d          dekompresja plikow .bin" << std::endl
+		<< "  -s gniazdo  serwer kompresji na gniezdzie domeny Unix" << std::endl
+		<< "  -t          uczenie zestawu czestosci o identyfikatorze 1-255 na plikach .xml" << std::endl
+		<< "  -T          uczenie slownika LZSS o identyfikatorze 1-255 na plikach .xml" << std::endl
+		<< "  -j watki    liczba watkow (domyslnie liczba rdzeni)" << std::endl
+		<< "  -o katalog  katalog wyjsciowy (domyslnie obok plikow zrodlowych)" << std::endl
+		<< "  -p plik     zestaw poczatkowych czestosci modeli" << std::endl
+		<< "  -x plik     slownik LZSS; zestaw czestosci nalezy uczyc z tym samym slownikiem" << std::endl
+		<< "  -k koder    koder entropijny sekcji: qs (domyslny, qsmodel), bit (binarny w stylu LZMA)," << std::endl
+		<< "              qs64 (qsmodel z koderem o 64-bitowym low), rans (przeplatany rANS)" << std::endl
+		<< "              lub huff (kody Huffmana, najszybszy)" << std::endl
+		<< "  -q modele   parametry modeli qsmodel: stale (domyslne) lub auto (wybierane dla kazdej" << std::endl
+		<< "              sekcji na poczatku jej danych; wolniejsza kompresja)" << std::endl
+		<< "  wejscie     katalog, plik lub @lista plikow" << std::endl;
+	return 2;
+}
 
-	CompresorXml cXml;
-	cXml.encode("samples/SwissProt.xml", "samples/SwissProt.xml.bin");
-	cXml.decode("samples/SwissProt.xml.bin", "samples/SwissProt.2.xml");
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		CompresorXml cXml;
+		cXml.encode("samples/SwissProt.xml", "samples/SwissProt.xml.bin");
+		cXml.decode("samples/SwissProt.xml.bin", "samples/SwissProt.2.xml");
+		return 0;
+	}
+
+	int arg = 2;
+	char const * socketPath = nullptr;
+	char const * trainedPath = nullptr;
+	int trainedId = 0;
+	char const * trainedName = nullptr;
+	BatchCompressor::Mode mode = BatchCompressor::Compress;
+	if (strcmp(argv[1], "-c") == 0)
+		mode = BatchCompressor::Compress;
+	else if (strcmp(argv[1], "-d") == 0)
+		mode = BatchCompressor::Decompress;
+	else if (strcmp(argv[1], "-s") == 0 && argc > 2)
+		socketPath = argv[arg++];
+	else if ((strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "-T") == 0) && argc > 4)
+	{
+		mode = argv[1][1] == 't' ? BatchCompressor::Train : BatchCompressor::TrainDictionary;
+		trainedPath = argv[arg++];
+		char * idEnd;
+		long id = strtol(argv[arg++], &idEnd, 10);
+		if (*idEnd != '\0' || id < 1 || id > 255)
+			return usage();
+		trainedId = static_cast<int>(id);
+		trainedName = argv[arg++];
+	}
+	else
+		return usage();
+
+	size_t threadCount = 0;
+	std::string outputDirectory;
+	std::string priorPath;
+	std::string dictionaryPath;
+	LzssCoder::Backend backend = LzssCoder::RANGE_CODER;
+	bool parameterSearch = false;
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if (arg + 1 == argc)
+			return usage();
+		if (strcmp(argv[arg], "-j") == 0)
+			threadCount = strtoul(argv[arg + 1], nullptr, 10);
+		else if (strcmp(argv[arg], "-o") == 0)
+			outputDirectory = argv[arg + 1];
+		else if (strcmp(argv[arg], "-p") == 0)
+			priorPath = argv[arg + 1];
+		else if (strcmp(argv[arg], "-x") == 0)
+			dictionaryPath = argv[arg + 1];
+		else if (strcmp(argv[arg], "-k") == 0 && strcmp(argv[arg + 1], "qs") == 0)
+			backend = LzssCoder::RANGE_CODER;
+		else if (strcmp(argv[arg], "-k") == 0 && strcmp(argv[arg + 1], "bit") == 0)
+			backend = LzssCoder::BINARY_CODER;
+		else if (strcmp(argv[arg], "-k") == 0 && strcmp(argv[arg + 1], "rans") == 0)
+			backend = LzssCoder::RANS_CODER;
+		else if (strcmp(argv[arg], "-k") == 0 && strcmp(argv[arg + 1], "huff") == 0)
+			backend = LzssCoder::HUFFMAN_CODER;
+		else if (strcmp(argv[arg], "-k") == 0 && strcmp(argv[arg + 1], "qs64") == 0)
+			backend = LzssCoder::WIDE_RANGE_CODER;
+		else if (strcmp(argv[arg], "-q") == 0 && strcmp(argv[arg + 1], "stale") == 0)
+			parameterSearch = false;
+		else if (strcmp(argv[arg], "-q") == 0 && strcmp(argv[arg + 1], "auto") == 0)
+			parameterSearch = true;
+		else
+			return usage();
+	}
+	if (socketPath ? arg != argc : arg >= argc)
+		return usage();
+	// opcje podawane sa przed plikami wejsciowymi
+	for (int input = arg; input < argc; ++input)
+	{
+		if (argv[input][0] == '-')
+			return usage();
+	}
+
+	try
+	{
+		std::shared_ptr<PriorSet const> priorSet;
+		if (!priorPath.empty())
+			priorSet = PriorSet::load(priorPath);
+		std::shared_ptr<LzDictionary const> dictionary;
+		if (!dictionaryPath.empty())
+			dictionary = LzDictionary::load(dictionaryPath);
+
+		if (socketPath)
+		{
+			CompressionServer server(socketPath, priorSet, dictionary, backend, parameterSearch);
+			server.run(threadCount);
+			return 1;
+		}
 
-	return 0;
-}
\ No newline at end of file
+		BatchCompressor batch(mode, outputDirectory);
+		batch.setPriorSet(priorSet);
+		batch.setDictionary(dictionary);
+		batch.setBackend(backend);
+		batch.setParameterSearch(parameterSearch);
+		for (; arg < argc; ++arg)
+			batch.add(argv[arg]);
+		size_t failed = batch.run(threadCount);
+		if (mode == BatchCompressor::Train)
+			PriorSet(trainedId, trainedName, batch.statistics()).save(trainedPath);
+		else if (mode == BatchCompressor::TrainDictionary)
+			LzDictionary(trainedId, trainedName, batch.samples()).save(trainedPath);
+		return failed == 0 ? 0 : 1;
+	}
+	catch (std::exception const & ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+}
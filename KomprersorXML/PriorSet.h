@@ -0,0 +1,171 @@
+#pragma once
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "LzssCoder.h"
+
+/// <summary>
+/// Nazwany zestaw poczatkowych czestosci modeli sekcji LZSS, wyuczony na korpusie plikow.
+/// Identyfikator zestawu zapisywany jest w naglowku skompresowanego pliku, dlatego dekompresja
+/// wymaga wczytania zestawu o tym samym identyfikatorze.
+/// </summary>
+class PriorSet
+{
+	/// <summary>
+	/// Poczatek pliku zestawu: sygnatura i wersja formatu
+	/// </summary>
+	static constexpr char const * SIGNATURE = "KXP\x01";
+	static const size_t SIGNATURE_SIZE = 4;
+
+	int _id;
+	std::string _name;
+
+	/// <summary>
+	/// Czestosci kolejnych sekcji LZSS w kolejnosci ich zapisu w pliku skompresowanym
+	/// </summary>
+	std::vector<LzssCoder::Frequencies> _sections;
+
+public:
+	/// <summary>
+	/// Identyfikator oznaczajacy brak zestawu
+	/// </summary>
+	static const int NONE = 0;
+
+	/// <summary>
+	/// Tworzy zestaw z liczby wystapien symboli zebranych przy kompresji korpusu.
+	/// </summary>
+	/// <param name="id">Identyfikator od 1 do 255.</param>
+	/// <param name="name">Nazwa zestawu.</param>
+	/// <param name="statistics">Liczniki symboli kolejnych sekcji.</param>
+	PriorSet(int id, std::string const & name, std::vector<LzssCoder::Frequencies> const & statistics)
+		: _id(id), _name(name), _sections(statistics)
+	{
+		if (id <= NONE || id > 255)
+			throw std::runtime_error("Identyfikator zestawu musi nalezec do przedzialu 1-255");
+		for (auto & section : _sections)
+			section.normalize();
+	}
+
+	int id() const
+	{
+		return _id;
+	}
+
+	std::string const & name() const
+	{
+		return _name;
+	}
+
+	size_t sectionCount() const
+	{
+		return _sections.size();
+	}
+
+	/// <summary>
+	/// Czestosci sekcji albo nullptr, jezeli zestaw jej nie obejmuje.
+	/// </summary>
+	LzssCoder::Frequencies const * section(size_t index) const
+	{
+		return index < _sections.size() ? &_sections[index] : nullptr;
+	}
+
+	/// <summary>
+	/// Wczytuje zestaw z pliku zapisanego przez save.
+	/// </summary>
+	/// <param name="path">Sciezka do pliku.</param>
+	static std::shared_ptr<PriorSet const> load(std::string const & path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Nie mozna otworzyc zestawu czestosci " + path);
+		char signature[SIGNATURE_SIZE];
+		file.read(signature, SIGNATURE_SIZE);
+		if (!file || !std::equal(signature, signature + SIGNATURE_SIZE, SIGNATURE))
+			throw std::runtime_error("Niepoprawny zestaw czestosci " + path);
+
+		std::shared_ptr<PriorSet> set(new PriorSet());
+		set->_id = file.get();
+		int nameLength = file.get();
+		set->_name.resize(std::max(nameLength, 0));
+		file.read(&set->_name[0], set->_name.size());
+		set->_sections.resize(std::max(file.get(), 0));
+		for (auto & section : set->_sections)
+		{
+			readArray(file, section.flags);
+			readArray(file, section.letters);
+			readArray(file, section.offsets);
+			for (auto & length : section.lengths)
+				readArray(file, length);
+		}
+		if (!file || set->_id <= NONE)
+			throw std::runtime_error("Niepoprawny zestaw czestosci " + path);
+		for (auto const & section : set->_sections)
+		{
+			if (!section.isValidPrior())
+				throw std::runtime_error("Niepoprawny zestaw czestosci " + path);
+		}
+		return set;
+	}
+
+	/// <summary>
+	/// Zapisuje zestaw do pliku.
+	/// </summary>
+	/// <param name="path">Sciezka do pliku.</param>
+	void save(std::string const & path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(SIGNATURE, SIGNATURE_SIZE);
+		file.put(static_cast<char>(_id));
+		size_t nameLength = std::min<size_t>(_name.size(), 255);
+		file.put(static_cast<char>(nameLength));
+		file.write(_name.data(), nameLength);
+		file.put(static_cast<char>(_sections.size()));
+		for (auto const & section : _sections)
+		{
+			writeArray(file, section.flags);
+			writeArray(file, section.letters);
+			writeArray(file, section.offsets);
+			for (auto const & length : section.lengths)
+				writeArray(file, length);
+		}
+		if (!file)
+			throw std::runtime_error("Nie mozna zapisac zestawu czestosci " + path);
+	}
+
+private:
+	PriorSet() : _id(NONE)
+	{
+	}
+
+	/// <summary>
+	/// Odczytuje tablice zapisana jako liczba elementow i elementy, wszystkie na 2 bajtach little-endian.
+	/// </summary>
+	static void readArray(std::istream & file, std::vector<int> & values)
+	{
+		values.resize(readShort(file));
+		for (int & value : values)
+			value = readShort(file);
+	}
+
+	static void writeArray(std::ostream & file, std::vector<int> const & values)
+	{
+		writeShort(file, static_cast<int>(values.size()));
+		for (int value : values)
+			writeShort(file, value);
+	}
+
+	static int readShort(std::istream & file)
+	{
+		int low = file.get();
+		int high = file.get();
+		return file ? low | high << 8 : 0;
+	}
+
+	static void writeShort(std::ostream & file, int value)
+	{
+		file.put(static_cast<char>(value & 0xFF));
+		file.put(static_cast<char>(value >> 8 & 0xFF));
+	}
+};
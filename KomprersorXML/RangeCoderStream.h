@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include "rangecod.h"
+
+/// <summary>
+/// Podlacza do kodera zakresowego strumienie bajtow w pamieci: przy kompresji bajty dopisywane sa
+/// na koniec wektora, a przy dekompresji czytane z wczytanego pliku od podanej pozycji.
+/// </summary>
+class RangeCoderStream
+{
+public:
+	/// <summary>
+	/// Ustawia wektor, na koniec ktorego koder dopisuje bajty.
+	/// </summary>
+	static void attachSink(rangecoder & rc, std::vector<char> & sink)
+	{
+		rc.putbyte = &append;
+		rc.sink = &sink;
+	}
+
+	/// <summary>
+	/// Ustawia zrodlo bajtow dekodera na zawartosc pliku od podanej pozycji.
+	/// </summary>
+	static void attachSource(rangecoder & rc, std::vector<char> const & source, int pos)
+	{
+		unsigned char const * data = reinterpret_cast<unsigned char const *>(source.data());
+		rc.inptr = data + pos;
+		rc.inend = data + source.size();
+	}
+
+	/// <summary>
+	/// Zwraca pozycje w pliku za ostatnim bajtem odczytanym przez dekoder.
+	/// </summary>
+	static int position(rangecoder const & rc, std::vector<char> const & source)
+	{
+		return static_cast<int>(rc.inptr - reinterpret_cast<unsigned char const *>(source.data()));
+	}
+
+	/// <summary>
+	/// Zwraca pozycje w pliku za zdekodowana sekcja. Dekoder moze nie odczytac koncowych bajtow sekcji,
+	/// w ktorych done_encoding zapisuje jej dlugosc; pozostawiony bajt rowny znakowi poczatku sekcji
+	/// bylby wziety za poczatek kolejnej, dlatego koniec sekcji wyznaczany jest z zapisanej dlugosci.
+	/// </summary>
+	/// <param name="rc">Dekoder po wywolaniu done_decoding.</param>
+	/// <param name="source">Zawartosc pliku.</param>
+	/// <param name="start">Pozycja pierwszego bajtu sekcji.</param>
+	static int sectionEnd(rangecoder const & rc, std::vector<char> const & source, int start)
+	{
+		int end = position(rc, source);
+		for (int unread = 0; unread <= LENGTH_BYTES; ++unread)
+		{
+			if (endsWithLength(source, start, end + unread))
+				return end + unread;
+		}
+		return end;
+	}
+
+private:
+	/// <summary>
+	/// Liczba koncowych bajtow sekcji zawierajacych jej dlugosc
+	/// </summary>
+	static const int LENGTH_BYTES = 3;
+
+	static bool endsWithLength(std::vector<char> const & source, int start, int end)
+	{
+		if (end - start <= LENGTH_BYTES || end > (int)source.size())
+			return false;
+		unsigned char const * length = reinterpret_cast<unsigned char const *>(source.data()) + end - LENGTH_BYTES;
+		return (length[0] << 16 | length[1] << 8 | length[2]) == ((end - start) & 0xFFFFFF);
+	}
+
+	static void append(void * sink, unsigned char c)
+	{
+		static_cast<std::vector<char> *>(sink)->push_back(static_cast<char>(c));
+	}
+};
@@ -0,0 +1,344 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/// <summary>
+/// Przeplatany koder rANS ze statycznymi modelami: symbole kodowane sa na zmiane czterema niezaleznymi
+/// 32-bitowymi stanami zapisujacymi bajty do jednego strumienia. Kolejne symbole dekodowane sa
+/// z roznych stanow, wiec procesor moze wykonywac ich obliczenia rownolegle. Czestosci modeli
+/// wyznaczane sa z calego bloku i zapisywane przed jego danymi.
+/// </summary>
+class RansCoder
+{
+public:
+	static const int SCALE_BITS = 12;
+	static const uint32_t SCALE = 1u << SCALE_BITS;
+	static const int STREAM_COUNT = 4;
+
+	/// <summary>
+	/// Przedzial symbolu w skali SCALE przekazywany do kodera
+	/// </summary>
+	struct Symbol
+	{
+		uint16_t start;
+		uint16_t frequency;
+	};
+
+	/// <summary>
+	/// Statyczny model symboli bloku. Zapisywane sa liczniki symboli, a obie strony wyznaczaja
+	/// z nich te same czestosci, dzieki czemu tablice malych blokow zajmuja malo miejsca.
+	/// </summary>
+	class Model
+	{
+		struct DecodeEntry
+		{
+			uint16_t symbol;
+			uint16_t frequency;
+			uint16_t bias;
+		};
+
+		std::vector<uint32_t> _counts;
+		std::vector<Symbol> _symbols;
+		std::vector<DecodeEntry> _decodeTable;
+
+	public:
+		explicit Model(int alphabetSize = 0) : _counts(alphabetSize, 0)
+		{
+		}
+
+		/// <summary>
+		/// Zeruje liczniki przed kolejnym blokiem.
+		/// </summary>
+		void clear()
+		{
+			std::fill(_counts.begin(), _counts.end(), 0);
+		}
+
+		void count(int symbol)
+		{
+			++_counts[symbol];
+		}
+
+		Symbol const & symbol(int symbol) const
+		{
+			return _symbols[symbol];
+		}
+
+		/// <summary>
+		/// Zapisuje liczniki: liczbe wystepujacych symboli, ich numery (odstepy miedzy kolejnymi albo mape
+		/// bitowa, zaleznie od tego, co krotsze) i liczniki jako liczby o zmiennej dlugosci.
+		/// Nastepnie wyznacza czestosci kodera.
+		/// </summary>
+		void save(std::vector<char> & target)
+		{
+			size_t present = _counts.size() - std::count(_counts.begin(), _counts.end(), 0u);
+			writeNumber(target, static_cast<uint32_t>(present));
+			size_t mapSize = (_counts.size() + 7) / 8;
+			if (present < mapSize)
+			{
+				int previous = -1;
+				for (int i = 0; i < (int)_counts.size(); ++i)
+				{
+					if (_counts[i] > 0)
+					{
+						writeNumber(target, i - previous - 1);
+						previous = i;
+					}
+				}
+			}
+			else
+			{
+				size_t mapStart = target.size();
+				target.resize(mapStart + mapSize, 0);
+				for (size_t i = 0; i < _counts.size(); ++i)
+				{
+					if (_counts[i] > 0)
+						target[mapStart + i / 8] |= static_cast<char>(1 << (i % 8));
+				}
+			}
+			for (uint32_t count : _counts)
+			{
+				if (count > 0)
+					writeNumber(target, count);
+			}
+			normalize();
+		}
+
+		/// <summary>
+		/// Wczytuje liczniki zapisane przez save i buduje tablice dekodera. Model bez symboli zostawia
+		/// w tablicy zerowe czestosci, ktore decode odrzuca.
+		/// </summary>
+		void load(std::vector<char> const & source, int & pos)
+		{
+			size_t present = readNumber(source, pos);
+			size_t mapSize = (_counts.size() + 7) / 8;
+			std::fill(_counts.begin(), _counts.end(), 0);
+			if (present < mapSize)
+			{
+				size_t symbol = 0;
+				for (size_t i = 0; i < present; ++i, ++symbol)
+				{
+					symbol += readNumber(source, pos);
+					if (symbol >= _counts.size())
+						throw std::runtime_error("Niepoprawna sekcja rANS");
+					_counts[symbol] = 1;
+				}
+			}
+			else
+			{
+				if (pos + mapSize > source.size())
+					throw std::runtime_error("Niepoprawna sekcja rANS");
+				for (size_t i = 0; i < _counts.size(); ++i)
+					_counts[i] = static_cast<unsigned char>(source[pos + i / 8]) >> (i % 8) & 1;
+				pos += static_cast<int>(mapSize);
+			}
+			for (uint32_t & count : _counts)
+			{
+				if (count > 0 && (count = readNumber(source, pos)) == 0)
+					throw std::runtime_error("Niepoprawna sekcja rANS");
+			}
+			normalize();
+			_decodeTable.assign(SCALE, DecodeEntry());
+			for (size_t s = 0; s < _symbols.size(); ++s)
+			{
+				for (uint32_t slot = _symbols[s].start; slot < uint32_t(_symbols[s].start) + _symbols[s].frequency; ++slot)
+				{
+					DecodeEntry & entry = _decodeTable[slot];
+					entry.symbol = static_cast<uint16_t>(s);
+					entry.frequency = _symbols[s].frequency;
+					entry.bias = static_cast<uint16_t>(slot - _symbols[s].start);
+				}
+			}
+		}
+
+		DecodeEntry const & entry(uint32_t slot) const
+		{
+			return _decodeTable[slot];
+		}
+
+	private:
+		/// <summary>
+		/// Zamienia liczniki na czestosci o sumie SCALE; kazdy wystepujacy symbol otrzymuje co najmniej 1.
+		/// Roznica z zaokraglen trafia do najczestszych symboli.
+		/// </summary>
+		void normalize()
+		{
+			const int n = static_cast<int>(_counts.size());
+			_symbols.assign(n, Symbol());
+			uint64_t sum = 0;
+			for (uint32_t count : _counts)
+				sum += count;
+			if (sum == 0)
+				return;
+			std::vector<int> frequencies(n);
+			int assigned = 0;
+			for (int i = 0; i < n; ++i)
+			{
+				if (_counts[i] > 0)
+					frequencies[i] = std::max(1, static_cast<int>(_counts[i] * uint64_t(SCALE) / sum));
+				assigned += frequencies[i];
+			}
+			std::vector<int> order(n);
+			for (int i = 0; i < n; ++i)
+				order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return _counts[a] > _counts[b]; });
+			for (int i = 0; assigned < int(SCALE); i = (i + 1) % n)
+			{
+				if (_counts[order[i]] > 0)
+				{
+					++frequencies[order[i]];
+					++assigned;
+				}
+			}
+			while (assigned > int(SCALE))
+			{
+				for (int i = 0; i < n && assigned > int(SCALE); ++i)
+				{
+					if (frequencies[order[i]] > 1)
+					{
+						--frequencies[order[i]];
+						--assigned;
+					}
+				}
+			}
+			uint32_t start = 0;
+			for (int i = 0; i < n; ++i)
+			{
+				_symbols[i].start = static_cast<uint16_t>(start);
+				_symbols[i].frequency = static_cast<uint16_t>(frequencies[i]);
+				start += frequencies[i];
+			}
+		}
+	};
+
+	/// <summary>
+	/// Symbol o rownomiernym rozkladzie: count najmlodszych bitow wartosci, count od 1 do SCALE_BITS.
+	/// </summary>
+	static Symbol bits(uint32_t value, int count)
+	{
+		Symbol symbol = { static_cast<uint16_t>(value << (SCALE_BITS - count)), static_cast<uint16_t>(1u << (SCALE_BITS - count)) };
+		return symbol;
+	}
+
+	/// <summary>
+	/// Koduje symbole bloku i dopisuje do wektora dlugosc danych jako liczbe o zmiennej dlugosci oraz dane.
+	/// Symbol i koduje stan i % STREAM_COUNT; symbole kodowane sa od konca, aby dekoder czytal je od poczatku.
+	/// </summary>
+	static void encode(std::vector<Symbol> const & symbols, std::vector<char> & target)
+	{
+		const uint32_t lowerBound = 1u << 23;
+		uint32_t states[STREAM_COUNT];
+		std::fill(states, states + STREAM_COUNT, lowerBound);
+		// bajty zapisywane sa od konca danych
+		std::vector<char> reversed;
+		reversed.reserve(symbols.size() + 4 * STREAM_COUNT);
+		for (size_t i = symbols.size(); i-- > 0;)
+		{
+			uint32_t & state = states[i % STREAM_COUNT];
+			Symbol const & symbol = symbols[i];
+			uint32_t limit = ((lowerBound >> SCALE_BITS) << 8) * symbol.frequency;
+			while (state >= limit)
+			{
+				reversed.push_back(static_cast<char>(state & 0xFF));
+				state >>= 8;
+			}
+			state = ((state / symbol.frequency) << SCALE_BITS) + state % symbol.frequency + symbol.start;
+		}
+		for (int i = STREAM_COUNT - 1; i >= 0; --i)
+		{
+			for (int shift = 24; shift >= 0; shift -= 8)
+				reversed.push_back(static_cast<char>(states[i] >> shift & 0xFF));
+		}
+		writeNumber(target, static_cast<uint32_t>(reversed.size()));
+		target.insert(target.end(), reversed.rbegin(), reversed.rend());
+	}
+
+	RansCoder() : _input(nullptr), _inputEnd(nullptr), _next(0)
+	{
+	}
+
+	/// <summary>
+	/// Rozpoczyna dekompresje bloku zapisanego przez encode od podanej pozycji; pozycja przesuwana jest za blok.
+	/// </summary>
+	void startDecoding(std::vector<char> const & source, int & pos)
+	{
+		uint32_t size = readNumber(source, pos);
+		unsigned char const * data = reinterpret_cast<unsigned char const *>(source.data());
+		if (size < 4 * STREAM_COUNT || size > source.size() - pos)
+			throw std::runtime_error("Niepoprawna sekcja rANS");
+		_input = data + pos;
+		_inputEnd = _input + size;
+		pos += size;
+		for (uint32_t & state : _states)
+		{
+			state = _input[0] | _input[1] << 8 | _input[2] << 16 | uint32_t(_input[3]) << 24;
+			_input += 4;
+		}
+		_next = 0;
+	}
+
+	int decode(Model const & model)
+	{
+		uint32_t & state = _states[_next++ % STREAM_COUNT];
+		auto const & entry = model.entry(state & (SCALE - 1));
+		if (entry.frequency == 0)
+			throw std::runtime_error("Niepoprawna sekcja rANS");
+		state = entry.frequency * (state >> SCALE_BITS) + entry.bias;
+		normalize(state);
+		return entry.symbol;
+	}
+
+	uint32_t decodeBits(int count)
+	{
+		uint32_t & state = _states[_next++ % STREAM_COUNT];
+		uint32_t slot = state & (SCALE - 1);
+		state = (1u << (SCALE_BITS - count)) * (state >> SCALE_BITS) + (slot & ((1u << (SCALE_BITS - count)) - 1));
+		normalize(state);
+		return slot >> (SCALE_BITS - count);
+	}
+
+	/// <summary>
+	/// Zapisuje liczbe nieujemna po 7 bitow na bajt, od najmlodszych.
+	/// </summary>
+	static void writeNumber(std::vector<char> & target, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			target.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		target.push_back(static_cast<char>(value));
+	}
+
+	static uint32_t readNumber(std::vector<char> const & source, int & pos)
+	{
+		uint32_t value = 0;
+		for (int shift = 0; shift < 32; shift += 7)
+		{
+			if (pos >= (int)source.size())
+				break;
+			unsigned char byte = source[pos++];
+			value |= uint32_t(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		throw std::runtime_error("Niepoprawna sekcja rANS");
+	}
+
+private:
+	unsigned char const * _input;
+	unsigned char const * _inputEnd;
+	uint32_t _states[STREAM_COUNT];
+	unsigned int _next;
+
+	/// <summary>
+	/// Uzupelnia stan bajtami danych; za koncem bloku zerami, aby uszkodzony plik nie powodowal odczytu poza nim.
+	/// </summary>
+	void normalize(uint32_t & state)
+	{
+		while (state < (1u << 23))
+			state = state << 8 | (_input < _inputEnd ? *_input++ : 0);
+	}
+};
@@ -1,31 +0,0 @@
-#pragma once
-#include <map>
-#include "ReadStrategyEnum.h"
-
-class AbstractReadByteStrategy;
-
-/// <summary>
-/// Fabryka tworzca nowe obiekty klas zarzdzajcych odczytywaniem pliku binarnego
-/// </summary>
-class ReadByteStrategyFactory
-{
-	typedef AbstractReadByteStrategy * (*CreateStrategyCallback)();
-	typedef std::map<ReadStrategy, CreateStrategyCallback> CallbackMap;
-
-	static ReadByteStrategyFactory * _pInstance;
-
-	CallbackMap _callbackMap;
-
-	ReadByteStrategyFactory();
-
-	static void destroy();
-
-public:
-	static ReadByteStrategyFactory & Instance();
-
-	bool registerStrategy(ReadStrategy name, CreateStrategyCallback callback);
-
-	bool unregister(ReadStrategy name);
-
-	AbstractReadByteStrategy * create(ReadStrategy name);
-};
\ No newline at end of file
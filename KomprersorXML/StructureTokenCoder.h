@@ -0,0 +1,267 @@
+#pragma once
+#include "port.h"
+#include "qsmodel.h"
+#include "rangecod.h"
+#include "RangeCoderStream.h"
+#include "WideRangeCoder.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/// <summary>
+/// Symbole struktury dokumentu. Po OPEN i ATTRIBUTE w strumieniu identyfikatorow zapisany jest
+/// identyfikator nazwy, a po symbolach wartosci jej bajty. Kolejnosc symboli wartosci
+/// odpowiada XmlValue::Type.
+/// </summary>
+enum StructureToken : char
+{
+	TOKEN_OPEN, TOKEN_ATTRIBUTE, TOKEN_CHILDREN, TOKEN_CLOSE,
+	TOKEN_STRING, TOKEN_CHAR, TOKEN_SHORT, TOKEN_INT, TOKEN_FLOAT,
+	TOKEN_END, TOKEN_COUNT
+};
+
+/// <summary>
+/// Koduje ciag symboli struktury koderem zakresowym. Kazdy symbol kodowany jest modelem adaptacyjnym
+/// wybranym przez poprzedni symbol oraz nazwe, ktorej on dotyczyl: znacznik otwierany, zamykany
+/// lub zawierajacy wartosc, albo atrybut. Z identyfikatora nazwy brane jest NAME_BITS najmlodszych bitow,
+/// wiec liczba modeli jest ograniczona niezaleznie od liczby nazw w dokumencie.
+/// </summary>
+class StructureTokenCoder
+{
+protected:
+	static const int TOKEN_BITS = 4;
+	static const int LG_TOTF = 12;
+	static const int RESCALE = 1024;
+	static const int COMPRESS = 1;
+	static const int DECOMPRESS = 0;
+	static const char START_SIGN = '!';
+
+	/// <summary>
+	/// Liczba bitow identyfikatora nazwy w kontekscie modelu
+	/// </summary>
+	static const int NAME_BITS = 8;
+
+	rangecoder rc;
+	WideRangeCoder _wide;
+
+	/// <summary>
+	/// Czy symbole kodowane sa koderem WideRangeCoder zamiast kodera z rangecod
+	/// </summary>
+	bool _wideRangeCoder;
+
+	/// <summary>
+	/// Czy kontekst obejmuje tylko NAME_BITS bitow identyfikatora nazwy; pliki w wersji ponizej 11
+	/// uzywaja calego identyfikatora
+	/// </summary>
+	bool _boundedContexts;
+
+	/// <summary>
+	/// Modele symboli tworzone przy pierwszym uzyciu kontekstu i usuwane przed kolejnym plikiem
+	/// </summary>
+	std::unordered_map<int, qsmodel> _models;
+
+	/// <summary>
+	/// Tryb, w ktorym utworzone zostaly modele
+	/// </summary>
+	int _modelMode;
+
+	/// <summary>
+	/// Kontekst nastepnego symbolu przy dekompresji
+	/// </summary>
+	int _context;
+
+	/// <summary>
+	/// Zawartosc pliku dekodowanego od startDecoding do doneDecoding i pozycja poczatku sekcji
+	/// </summary>
+	std::vector<char> const * _source;
+	int _start;
+
+public:
+	StructureTokenCoder() : _wideRangeCoder(false), _boundedContexts(true), _modelMode(COMPRESS)
+	{
+	}
+
+	/// <summary>
+	/// Wybiera koder zakresowy kolejnych sekcji. Koder i dekoder sekcji musza uzywac tego samego kodera.
+	/// </summary>
+	void setWideRangeCoder(bool enabled)
+	{
+		_wideRangeCoder = enabled;
+	}
+
+	/// <summary>
+	/// Wybiera, czy kontekst modelu obejmuje tylko NAME_BITS bitow identyfikatora nazwy.
+	/// Koder i dekoder sekcji musza uzywac tego samego ustawienia.
+	/// </summary>
+	void setBoundedContexts(bool enabled)
+	{
+		_boundedContexts = enabled;
+	}
+
+	~StructureTokenCoder()
+	{
+		deleteModels();
+	}
+
+	/// <summary>
+	/// Laczy symbol z identyfikatorem znacznika, ktorego dotyczy, w element ciagu przekazywanego do encode.
+	/// </summary>
+	static int markupSymbol(StructureToken token, int id)
+	{
+		return int(unsigned(id) << (TOKEN_BITS + 1) | unsigned(token));
+	}
+
+	/// <summary>
+	/// Laczy symbol z identyfikatorem atrybutu, ktorego dotyczy, w element ciagu przekazywanego do encode.
+	/// </summary>
+	static int attributeSymbol(StructureToken token, int id)
+	{
+		return int((unsigned(id) << 1 | 1u) << TOKEN_BITS | unsigned(token));
+	}
+
+	/// <summary>
+	/// Kompresuje symbole struktury na koniec pliku wyjsciowego.
+	/// </summary>
+	/// <param name="symbols">Symbole polaczone z identyfikatorami nazw, bez symbolu konca.</param>
+	/// <param name="target">Zawartosc pliku wyjsciowego, na koniec ktorej dopisywana jest sekcja.</param>
+	void encode(std::vector<int> const & symbols, std::vector<char> & target)
+	{
+		resetModels(COMPRESS);
+		if (_wideRangeCoder)
+		{
+			target.push_back(char(START_SIGN));
+			_wide.startEncoding(target);
+		}
+		else
+		{
+			RangeCoderStream::attachSink(rc, target);
+			start_encoding(&rc, START_SIGN, 0);
+		}
+		int context = TOKEN_END;
+		for (int current : symbols)
+		{
+			saveSymbol(model(context), current & TOKEN_MASK);
+			context = current;
+		}
+		saveSymbol(model(context), TOKEN_END);
+		if (_wideRangeCoder)
+			_wide.doneEncoding();
+		else
+			done_encoding(&rc);
+	}
+
+	/// <summary>
+	/// Rozpoczyna dekompresje symboli struktury. Symbole odczytywane sa kolejno przez decode,
+	/// a po kazdym z nich nalezy podac identyfikator nazwy przez setMarkup albo setAttribute.
+	/// </summary>
+	/// <param name="source">Zawartosc pliku wejsciowego.</param>
+	/// <param name="pos">Pozycja od ktorej rozpoczac dekompresje.</param>
+	void startDecoding(std::vector<char> const & source, int pos)
+	{
+		_source = &source;
+		_start = pos;
+		resetModels(DECOMPRESS);
+		if (_wideRangeCoder)
+			_wide.startDecoding(source, pos + 1);
+		else
+		{
+			RangeCoderStream::attachSource(rc, source, pos);
+			start_decoding(&rc);
+		}
+		_context = TOKEN_END;
+	}
+
+	/// <summary>
+	/// Odczytuje kolejny symbol struktury.
+	/// </summary>
+	StructureToken decode()
+	{
+		qsmodel & current = model(_context);
+		int ltfreq = _wideRangeCoder ? _wide.decodeShift(LG_TOTF) : decode_culshift(&rc, LG_TOTF);
+		int token = qsgetsym(&current, ltfreq);
+		loadSymbol(current, token);
+		_context = token;
+		return StructureToken(token);
+	}
+
+	/// <summary>
+	/// Ustawia znacznik, ktorego dotyczyl ostatnio odczytany symbol.
+	/// </summary>
+	void setMarkup(int id)
+	{
+		_context = markupSymbol(StructureToken(_context & TOKEN_MASK), id);
+	}
+
+	/// <summary>
+	/// Ustawia atrybut, ktorego dotyczyl ostatnio odczytany symbol.
+	/// </summary>
+	void setAttribute(int id)
+	{
+		_context = attributeSymbol(StructureToken(_context & TOKEN_MASK), id);
+	}
+
+	/// <summary>
+	/// Konczy dekompresje symboli struktury.
+	/// </summary>
+	/// <param name="pos">Pozycja w pliku za sekcja symboli.</param>
+	void doneDecoding(int & pos)
+	{
+		if (_wideRangeCoder)
+			pos = _wide.sectionEnd(*_source);
+		else
+		{
+			done_decoding(&rc);
+			pos = RangeCoderStream::sectionEnd(rc, *_source, _start);
+		}
+	}
+
+protected:
+	static const int TOKEN_MASK = (1 << TOKEN_BITS) - 1;
+
+	qsmodel & model(int context)
+	{
+		if (_boundedContexts)
+			context &= (1 << (NAME_BITS + TOKEN_BITS + 1)) - 1;
+		auto found = _models.find(context);
+		if (found != _models.end())
+			return found->second;
+		qsmodel & created = _models[context];
+		initqsmodel(&created, TOKEN_COUNT, LG_TOTF, RESCALE, NULL, _modelMode);
+		return created;
+	}
+
+	void resetModels(int mode)
+	{
+		deleteModels();
+		_modelMode = mode;
+	}
+
+	void deleteModels()
+	{
+		for (auto & model : _models)
+			deleteqsmodel(&model.second);
+		_models.clear();
+	}
+
+	void saveSymbol(qsmodel & model, int symbol)
+	{
+		int sysfreq, ltfreq;
+		qsgetfreq(&model, symbol, &sysfreq, &ltfreq);
+		if (_wideRangeCoder)
+			_wide.encodeShift(sysfreq, ltfreq, LG_TOTF);
+		else
+			encode_shift(&rc, sysfreq, ltfreq, LG_TOTF);
+		qsupdate(&model, symbol);
+	}
+
+	void loadSymbol(qsmodel & model, int symbol)
+	{
+		int sysfreq, ltfreq;
+		qsgetfreq(&model, symbol, &sysfreq, &ltfreq);
+		if (_wideRangeCoder)
+			_wide.decodeUpdate(sysfreq, ltfreq, LG_TOTF);
+		else
+			decode_update(&rc, sysfreq, ltfreq, 1 << LG_TOTF);
+		qsupdate(&model, symbol);
+	}
+};
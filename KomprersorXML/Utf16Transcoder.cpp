@@ -0,0 +1,171 @@
+#include "Utf16Transcoder.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define UTF16_TRANSCODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const unsigned int REPLACEMENT_CHARACTER = 0xFFFD;
+
+	unsigned int readUnit(unsigned char const * source, bool bigEndian)
+	{
+		return bigEndian ? (source[0] << 8 | source[1]) : (source[1] << 8 | source[0]);
+	}
+
+	void writeUnit(unsigned int unit, bool bigEndian, std::string & target)
+	{
+		char bytes[2];
+		bytes[bigEndian ? 0 : 1] = char(unit >> 8);
+		bytes[bigEndian ? 1 : 0] = char(unit & 0xFF);
+		target.append(bytes, 2);
+	}
+
+	size_t writeUtf8(unsigned int codePoint, char * target)
+	{
+		if (codePoint < 0x80)
+		{
+			target[0] = char(codePoint);
+			return 1;
+		}
+		if (codePoint < 0x800)
+		{
+			target[0] = char(0xC0 | codePoint >> 6);
+			target[1] = char(0x80 | (codePoint & 0x3F));
+			return 2;
+		}
+		if (codePoint < 0x10000)
+		{
+			target[0] = char(0xE0 | codePoint >> 12);
+			target[1] = char(0x80 | (codePoint >> 6 & 0x3F));
+			target[2] = char(0x80 | (codePoint & 0x3F));
+			return 3;
+		}
+		target[0] = char(0xF0 | codePoint >> 18);
+		target[1] = char(0x80 | (codePoint >> 12 & 0x3F));
+		target[2] = char(0x80 | (codePoint >> 6 & 0x3F));
+		target[3] = char(0x80 | (codePoint & 0x3F));
+		return 4;
+	}
+
+	/// odczytuje jeden znak UTF-8, przesuwajac indeks za jego ostatni bajt
+	unsigned int readUtf8(unsigned char const * source, size_t length, size_t & index)
+	{
+		unsigned int lead = source[index++];
+		if (lead < 0x80)
+			return lead;
+		int extra;
+		unsigned int codePoint, minimum;
+		if ((lead & 0xE0) == 0xC0)
+			extra = 1, codePoint = lead & 0x1F, minimum = 0x80;
+		else if ((lead & 0xF0) == 0xE0)
+			extra = 2, codePoint = lead & 0x0F, minimum = 0x800;
+		else if ((lead & 0xF8) == 0xF0)
+			extra = 3, codePoint = lead & 0x07, minimum = 0x10000;
+		else
+			return REPLACEMENT_CHARACTER;
+		for (int i = 0; i < extra; ++i)
+		{
+			if (index >= length || (source[index] & 0xC0) != 0x80)
+				return REPLACEMENT_CHARACTER;
+			codePoint = codePoint << 6 | (source[index++] & 0x3F);
+		}
+		if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint < 0xE000))
+			return REPLACEMENT_CHARACTER;
+		return codePoint;
+	}
+
+#ifdef UTF16_TRANSCODER_SSE2
+	__m128i swapBytes(__m128i units)
+	{
+		return _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+	}
+#endif
+}
+
+size_t Utf16Transcoder::toUtf8(unsigned char const * source, size_t length, bool bigEndian, char * target)
+{
+	size_t units = length / 2, i = 0;
+	char * out = target;
+	while (i < units)
+	{
+#ifdef UTF16_TRANSCODER_SSE2
+		// 8 jednostek ASCII naraz: bajty starsze zerowe, mlodsze < 0x80
+		if (i + 8 <= units)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(source + 2 * i));
+			if (bigEndian)
+				block = swapBytes(block);
+			__m128i nonAscii = _mm_and_si128(block, _mm_set1_epi16(short(0xFF80)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) == 0xFFFF)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(block, block));
+				out += 8;
+				i += 8;
+				continue;
+			}
+		}
+#endif
+		unsigned int unit = readUnit(source + 2 * i, bigEndian);
+		++i;
+		unsigned int codePoint = unit;
+		if (unit >= 0xD800 && unit < 0xDC00)
+		{
+			unsigned int low = i < units ? readUnit(source + 2 * i, bigEndian) : 0;
+			if (low >= 0xDC00 && low < 0xE000)
+			{
+				codePoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+				++i;
+			}
+			else
+				codePoint = REPLACEMENT_CHARACTER;
+		}
+		else if (unit >= 0xDC00 && unit < 0xE000)
+			codePoint = REPLACEMENT_CHARACTER;
+		out += writeUtf8(codePoint, out);
+	}
+	return out - target;
+}
+
+void Utf16Transcoder::fromUtf8(char const * source, size_t length, bool bigEndian, std::string & target)
+{
+	unsigned char const * bytes = reinterpret_cast<unsigned char const *>(source);
+	target.reserve(target.size() + 2 * length);
+	size_t i = 0;
+	while (i < length)
+	{
+#ifdef UTF16_TRANSCODER_SSE2
+		// 16 bajtow ASCII naraz rozszerzanych do 16 jednostek
+		if (i + 16 <= length)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + i));
+			if (_mm_movemask_epi8(block) == 0)
+			{
+				__m128i low = _mm_unpacklo_epi8(block, _mm_setzero_si128());
+				__m128i high = _mm_unpackhi_epi8(block, _mm_setzero_si128());
+				if (bigEndian)
+				{
+					low = swapBytes(low);
+					high = swapBytes(high);
+				}
+				char units[32];
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(units), low);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(units + 16), high);
+				target.append(units, 32);
+				i += 16;
+				continue;
+			}
+		}
+#endif
+		unsigned int codePoint = readUtf8(bytes, length, i);
+		if (codePoint >= 0x10000)
+		{
+			codePoint -= 0x10000;
+			writeUnit(0xD800 + (codePoint >> 10), bigEndian, target);
+			writeUnit(0xDC00 + (codePoint & 0x3FF), bigEndian, target);
+		}
+		else
+			writeUnit(codePoint, bigEndian, target);
+	}
+}
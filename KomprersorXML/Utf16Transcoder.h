@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+/// <summary>
+/// Konwersja tekstu pomiedzy UTF-16 (LE/BE) a UTF-8. Fragmenty zlozone wylacznie ze znakow ASCII
+/// przetwarzane sa wektorowo (SSE2), pozostale znaki pojedynczo.
+/// Niepoprawne sekwencje zastepowane sa znakiem U+FFFD.
+/// </summary>
+class Utf16Transcoder
+{
+public:
+	/// <summary>
+	/// Zamienia tekst UTF-16 na UTF-8.
+	/// </summary>
+	/// <param name="source">Bajty tekstu UTF-16 bez BOM.</param>
+	/// <param name="length">Liczba bajtow; nieparzysty ostatni bajt jest pomijany.</param>
+	/// <param name="bigEndian">Czy jednostki zapisane sa w kolejnosci big-endian.</param>
+	/// <param name="target">Bufor o rozmiarze co najmniej maxUtf8Length(length).</param>
+	/// <returns>Liczba zapisanych bajtow UTF-8</returns>
+	static size_t toUtf8(unsigned char const * source, size_t length, bool bigEndian, char * target);
+
+	/// <summary>
+	/// Zamienia tekst UTF-8 na UTF-16, dopisujac wynik na koniec lancucha.
+	/// </summary>
+	/// <param name="source">Tekst UTF-8.</param>
+	/// <param name="length">Liczba bajtow.</param>
+	/// <param name="bigEndian">Czy jednostki zapisac w kolejnosci big-endian.</param>
+	/// <param name="target">Lancuch wyjsciowy.</param>
+	static void fromUtf8(char const * source, size_t length, bool bigEndian, std::string & target);
+
+	/// <summary>
+	/// Maksymalny rozmiar tekstu UTF-8 powstalego z podanej liczby bajtow UTF-16.
+	/// </summary>
+	static size_t maxUtf8Length(size_t length)
+	{
+		return length / 2 * 3;
+	}
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Koder zakresowy z 64-bitowym low, ktory normalizuje sie 32-bitowymi slowami zapisywanymi wprost
+/// do wektora. Przeniesienie dodawane jest do juz zapisanych bajtow, dlatego koder nie wstrzymuje
+/// bajtow 0xFF. Zakres po normalizacji ma co najmniej 32 znaczace bity, wiec symbol o czestosci
+/// w skali do 1 &lt;&lt; 16 wymaga co najwyzej jednej normalizacji.
+/// Symbole podawane sa jak w encode_shift z rangecod: czestosc, suma czestosci mniejszych symboli
+/// i logarytm sumy wszystkich czestosci.
+/// </summary>
+class WideRangeCoder
+{
+	static const uint64_t BOTTOM = uint64_t(1) << 32;
+
+	/// <summary>
+	/// Liczba bajtow zapisywanych na koniec; dekoder czyta dalej, bo uzupelnia stan pelnymi slowami
+	/// </summary>
+	static const int FLUSH_BYTES = 5;
+	static const int OVERREAD_BYTES = 8 - FLUSH_BYTES;
+
+	std::vector<char> * _sink;
+	unsigned char const * _input;
+	unsigned char const * _inputEnd;
+	uint64_t _low;
+	uint64_t _range;
+
+	/// <summary>
+	/// Dlugosc przedzialu jednostki czestosci wyznaczona przez decodeShift dla decodeUpdate
+	/// </summary>
+	uint64_t _unit;
+
+public:
+	WideRangeCoder() : _sink(nullptr), _input(nullptr), _inputEnd(nullptr), _low(0), _range(0), _unit(0)
+	{
+	}
+
+	/// <summary>
+	/// Rozpoczyna kompresje; bajty dopisywane sa na koniec wektora.
+	/// </summary>
+	void startEncoding(std::vector<char> & sink)
+	{
+		_sink = &sink;
+		_low = 0;
+		_range = ~uint64_t(0);
+	}
+
+	void encodeShift(uint32_t frequency, uint32_t lower, int shift)
+	{
+		uint64_t unit = _range >> shift;
+		uint64_t start = unit * lower;
+		addToLow(start);
+		// ostatni symbol otrzymuje reszte z zaokraglenia zakresu
+		if ((lower + frequency) >> shift)
+			_range -= start;
+		else
+			_range = unit * frequency;
+		if (_range < BOTTOM)
+		{
+			writeWord(static_cast<uint32_t>(_low >> 32));
+			_low <<= 32;
+			_range <<= 32;
+		}
+	}
+
+	/// <summary>
+	/// Zapisuje najstarsze bajty liczby z przedzialu koncowego zaokraglonej w gore tak,
+	/// aby dowolne bajty odczytane przez dekoder za koncem sekcji nie wyprowadzily jej poza przedzial.
+	/// </summary>
+	void doneEncoding()
+	{
+		const int droppedBits = 8 * OVERREAD_BYTES;
+		const uint64_t mask = (uint64_t(1) << droppedBits) - 1;
+		addToLow(mask);
+		_low &= ~mask;
+		for (int i = 0; i < FLUSH_BYTES; ++i)
+			_sink->push_back(static_cast<char>(_low >> (56 - 8 * i) & 0xFF));
+	}
+
+	/// <summary>
+	/// Rozpoczyna dekompresje zawartosci pliku od podanej pozycji.
+	/// </summary>
+	void startDecoding(std::vector<char> const & source, int pos)
+	{
+		_input = reinterpret_cast<unsigned char const *>(source.data()) + pos;
+		_inputEnd = reinterpret_cast<unsigned char const *>(source.data()) + source.size();
+		_range = ~uint64_t(0);
+		_low = uint64_t(readWord()) << 32 | readWord();
+	}
+
+	/// <summary>
+	/// Zwraca sume czestosci symboli mniejszych od kolejnego symbolu lub jej przyblizenie
+	/// z przedzialu czestosci tego symbolu. Stan zmienia dopiero decodeUpdate.
+	/// </summary>
+	uint32_t decodeShift(int shift)
+	{
+		_unit = _range >> shift;
+		uint64_t value = _low / _unit;
+		uint64_t last = (uint64_t(1) << shift) - 1;
+		return static_cast<uint32_t>(value < last ? value : last);
+	}
+
+	void decodeUpdate(uint32_t frequency, uint32_t lower, int shift)
+	{
+		uint64_t start = _unit * lower;
+		_low -= start;
+		if ((lower + frequency) >> shift)
+			_range -= start;
+		else
+			_range = _unit * frequency;
+		if (_range < BOTTOM)
+		{
+			_low = _low << 32 | readWord();
+			_range <<= 32;
+		}
+	}
+
+	/// <summary>
+	/// Zwraca pozycje w pliku za sekcja, po zdekodowaniu wszystkich jej symboli.
+	/// </summary>
+	int sectionEnd(std::vector<char> const & source) const
+	{
+		return static_cast<int>(_input - reinterpret_cast<unsigned char const *>(source.data())) - OVERREAD_BYTES;
+	}
+
+private:
+	/// <summary>
+	/// Dodaje do low i przenosi nadmiar do zapisanych bajtow; przeniesienie nie siega poza poczatek sekcji,
+	/// bo koniec przedzialu nigdy nie przekracza poczatkowego zakresu.
+	/// </summary>
+	void addToLow(uint64_t value)
+	{
+		_low += value;
+		if (_low >= value)
+			return;
+		for (size_t i = _sink->size(); i-- > 0;)
+		{
+			char & byte = (*_sink)[i];
+			byte = static_cast<char>(static_cast<unsigned char>(byte) + 1);
+			if (byte != 0)
+				break;
+		}
+	}
+
+	void writeWord(uint32_t word)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+			_sink->push_back(static_cast<char>(word >> shift & 0xFF));
+	}
+
+	/// <summary>
+	/// Kolejne slowo wejscia od najstarszego bajtu; za koncem pliku zera, ale pozycja przesuwana jest
+	/// zawsze o cale slowo, aby sectionEnd nie zalezal od polozenia sekcji w pliku.
+	/// </summary>
+	uint32_t readWord()
+	{
+		uint32_t word = 0;
+		for (int i = 0; i < 4; ++i, ++_input)
+			word = word << 8 | (_input < _inputEnd ? *_input : 0);
+		return word;
+	}
+};
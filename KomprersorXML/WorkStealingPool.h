@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Pula watkow z kradzieza zadan. Zadania rozdzielane sa kolejno miedzy kolejki watkow; watek,
+/// ktorego kolejka jest pusta, zabiera pierwsze zadanie z kolejki innego watku.
+/// </summary>
+template <class Job>
+class WorkStealingPool
+{
+	/// <summary>
+	/// Kolejka zadan jednego watku
+	/// </summary>
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+
+public:
+	/// <summary>
+	/// Wykonuje wszystkie zadania i czeka na ich zakonczenie. Kazdy watek pobiera zadania
+	/// w kolejnosci, w jakiej zostaly podane, wiec zadania posortowane malejaco wedlug kosztu
+	/// zaczynane sa od najwiekszych.
+	/// </summary>
+	/// <param name="jobs">Zadania.</param>
+	/// <param name="threadCount">Liczba watkow.</param>
+	/// <param name="function">Funkcja wywolywana jako function(numer watku, zadanie).</param>
+	template <class Function>
+	void run(std::vector<Job> const & jobs, size_t threadCount, Function function)
+	{
+		threadCount = std::max<size_t>(1, std::min(threadCount, jobs.size()));
+		_queues.clear();
+		for (size_t i = 0; i < threadCount; ++i)
+			_queues.emplace_back(new WorkerQueue());
+		for (size_t i = 0; i < jobs.size(); ++i)
+			_queues[i % threadCount]->jobs.push_back(jobs[i]);
+
+		std::vector<std::thread> workers;
+		for (size_t worker = 0; worker < threadCount; ++worker)
+		{
+			workers.emplace_back([this, worker, &function]()
+			{
+				Job job;
+				while (take(worker, job))
+					function(worker, job);
+			});
+		}
+		for (auto & worker : workers)
+			worker.join();
+		_queues.clear();
+	}
+
+private:
+	/// <summary>
+	/// Pobiera zadanie z wlasnej kolejki, a jezeli jest pusta, z kolejek pozostalych watkow.
+	/// Zadania nie sa dodawane w trakcie pracy, wiec puste kolejki oznaczaja koniec.
+	/// </summary>
+	bool take(size_t worker, Job & job)
+	{
+		for (size_t i = 0; i < _queues.size(); ++i)
+		{
+			WorkerQueue & queue = *_queues[(worker + i) % _queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.jobs.empty())
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include "rapidxml\rapidxml.hpp"
+#include "AbstractXmlDecodeHandler.h"
+#include "XmlValueFormatter.h"
+
+using namespace rapidxml;
+
+/// <summary>
+/// Odbiorca zdarzen dekompresji budujacy drzewo rapidxml. Wezly, atrybuty i wartosci alokowane sa
+/// z puli pamieci dokumentu, a nazwy wskazuja na jeden wspolny blok nazw, wiec drzewo nie wymaga
+/// tworzenia tekstu Xml i ponownego parsowania. Uklad wezlow odpowiada parsowaniu z flagami 0.
+/// </summary>
+class XmlDocumentHandler
+{
+	typedef std::unordered_map<int, std::string> NameMap;
+
+	xml_document<> & _doc;
+
+	/// <summary>
+	/// Wezel, do ktorego dolaczane sa kolejne dzieci i atrybuty
+	/// </summary>
+	xml_node<> * _current;
+
+	/// <summary>
+	/// Nazwy znacznikow i atrybutow w bloku nazw, indeksowane identyfikatorem
+	/// </summary>
+	std::vector<char *> _markupNames, _attributeNames;
+	std::vector<size_t> _markupNameSizes, _attributeNameSizes;
+
+public:
+	explicit XmlDocumentHandler(xml_document<> & doc) : _doc(doc), _current(&doc) { }
+
+	/// <summary>
+	/// Kopiuje wszystkie nazwy do jednego bloku w puli pamieci dokumentu.
+	/// </summary>
+	/// <param name="markupNames">Mapa identyfikatorow i nazw znacznikow.</param>
+	/// <param name="attributeNames">Mapa identyfikatorow i nazw atrybutow.</param>
+	void setNames(NameMap const & markupNames, NameMap const & attributeNames)
+	{
+		size_t blobSize = 0;
+		for (NameMap::const_iterator it = markupNames.begin(); it != markupNames.end(); ++it)
+			blobSize += it->second.size() + 1;
+		for (NameMap::const_iterator it = attributeNames.begin(); it != attributeNames.end(); ++it)
+			blobSize += it->second.size() + 1;
+		char * blob = _doc.allocate_string(0, blobSize > 0 ? blobSize : 1);
+		blob = fillNames(markupNames, blob, _markupNames, _markupNameSizes);
+		fillNames(attributeNames, blob, _attributeNames, _attributeNameSizes);
+	}
+
+	void startElement(int id, std::string const & /*name*/)
+	{
+		xml_node<> * node = _doc.allocate_node(node_element, _markupNames[id], 0, _markupNameSizes[id], 0);
+		_current->append_node(node);
+		_current = node;
+	}
+
+	void attribute(int id, std::string const & /*name*/, XmlValue const & value)
+	{
+		size_t size;
+		char * text = allocateValue(value, size);
+		_current->append_attribute(_doc.allocate_attribute(_attributeNames[id], text, _attributeNameSizes[id], size));
+	}
+
+	void text(XmlValue const & value)
+	{
+		size_t size;
+		char * text = allocateValue(value, size);
+		_current->value(text, size);
+		_current->append_node(_doc.allocate_node(node_data, 0, text, 0, size));
+	}
+
+	void endElement(int /*id*/, std::string const & /*name*/)
+	{
+		_current = _current->parent();
+	}
+
+private:
+	char * fillNames(NameMap const & names, char * blob, std::vector<char *> & pointers, std::vector<size_t> & sizes)
+	{
+		for (NameMap::const_iterator it = names.begin(); it != names.end(); ++it)
+		{
+			if (it->first < 0)
+				continue;
+			if (pointers.size() <= size_t(it->first))
+			{
+				pointers.resize(it->first + 1, blob);
+				sizes.resize(it->first + 1, 0);
+			}
+			memcpy(blob, it->second.data(), it->second.size());
+			pointers[it->first] = blob;
+			sizes[it->first] = it->second.size();
+			blob += it->second.size();
+			*blob++ = '\0';
+		}
+		return blob;
+	}
+
+	/// <summary>
+	/// Kopiuje wartosc do puli pamieci dokumentu jako tekst zakonczony zerem.
+	/// </summary>
+	char * allocateValue(XmlValue const & value, size_t & size)
+	{
+		char formatted[XmlValueFormatter::MAX_LENGTH];
+		char const * text = value.text;
+		size = value.length;
+		if (value.type != XmlValue::String)
+		{
+			size = XmlValueFormatter::format(value, formatted);
+			text = formatted;
+		}
+		char * result = _doc.allocate_string(0, size + 1);
+		memcpy(result, text, size);
+		result[size] = '\0';
+		return result;
+	}
+};
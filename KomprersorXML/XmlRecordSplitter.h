@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+/// <summary>
+/// Wyszukuje granice rekordow najwyzszego poziomu (dzieci korzenia) w surowym tekscie Xml,
+/// dzielac zawartosc korzenia na fragmenty, ktore mozna parsowac niezaleznie.
+/// </summary>
+class XmlRecordSplitter
+{
+public:
+	/// <summary>
+	/// Przedzial [begin, end) w tekscie zrodlowym
+	/// </summary>
+	struct Range
+	{
+		size_t begin, end;
+	};
+
+	/// <summary>
+	/// Dzieli zawartosc korzenia na co najwyzej shardCount fragmentow o zblizonym rozmiarze.
+	/// Kazdy fragment zawiera wylacznie cale rekordy, a granice wypadaja na glebokosci 1.
+	/// </summary>
+	/// <param name="text">Tekst Xml zakonczony znakiem '\0'.</param>
+	/// <param name="length">Dlugosc tekstu.</param>
+	/// <param name="shardCount">Maksymalna liczba fragmentow.</param>
+	/// <param name="rootTag">Przedzial od '<' do '>' (wylacznie) znacznika otwierajacego korzen.</param>
+	/// <param name="shards">Wyjsciowe fragmenty zawartosci korzenia.</param>
+	/// <returns><c>true</c> jezeli dokument udalo sie podzielic na co najmniej dwa fragmenty</returns>
+	bool split(char const * text, size_t length, size_t shardCount, Range & rootTag, std::vector<Range> & shards)
+	{
+		_text = text;
+		_length = length;
+		shards.clear();
+		if (shardCount < 2)
+			return false;
+
+		// znacznik otwierajacy korzen
+		size_t pos = skipProlog(0);
+		if (pos == npos)
+			return false;
+		size_t tagEnd = findTagEnd(pos);
+		if (tagEnd == npos || _text[tagEnd - 1] == '/')
+			return false;
+		rootTag.begin = pos;
+		rootTag.end = tagEnd;
+
+		size_t contentBegin = tagEnd + 1;
+		size_t targetSize = (_length - contentBegin) / shardCount;
+		size_t nextTarget = contentBegin + targetSize;
+		size_t shardBegin = contentBegin;
+		size_t rootEnd = npos;
+		int depth = 1;
+		pos = contentBegin;
+		while (rootEnd == npos)
+		{
+			char const * lt = static_cast<char const *>(memchr(_text + pos, '<', _length - pos));
+			if (lt == nullptr)
+				return false;
+			size_t tag = lt - _text;
+			// tekst bezposrednio w korzeniu nie trafilby do zadnego fragmentu
+			if (depth == 1 && !isWhitespace(pos, tag))
+				return false;
+			if (startsWith(tag, "<!--"))
+			{
+				pos = skipPast(tag, "-->");
+			}
+			else if (startsWith(tag, "<![CDATA["))
+			{
+				if (depth == 1)
+					return false;
+				pos = skipPast(tag, "]]>");
+			}
+			else if (startsWith(tag, "<?"))
+			{
+				pos = skipPast(tag, "?>");
+			}
+			else if (startsWith(tag, "<!"))
+			{
+				return false;
+			}
+			else
+			{
+				size_t end = findTagEnd(tag);
+				if (end == npos)
+					return false;
+				if (_text[tag + 1] == '/')
+				{
+					if (--depth == 0)
+						rootEnd = tag;
+				}
+				else if (_text[end - 1] != '/')
+				{
+					++depth;
+				}
+				pos = end + 1;
+				// koniec rekordu najwyzszego poziomu
+				if (depth == 1 && pos >= nextTarget && shards.size() < shardCount - 1)
+				{
+					shards.push_back({ shardBegin, pos });
+					shardBegin = pos;
+					nextTarget = pos + targetSize;
+				}
+			}
+			if (pos == npos)
+				return false;
+		}
+		shards.push_back({ shardBegin, rootEnd });
+
+		// za korzeniem dopuszczalne sa tylko komentarze i instrukcje przetwarzania
+		pos = rootEnd;
+		for (char const * lt; (lt = static_cast<char const *>(memchr(_text + pos + 1, '<', _length - pos - 1))) != nullptr; )
+		{
+			pos = lt - _text;
+			if (!startsWith(pos, "<!--") && !startsWith(pos, "<?"))
+				return false;
+		}
+		return shards.size() >= 2;
+	}
+
+private:
+	static const size_t npos = size_t(-1);
+
+	char const * _text;
+	size_t _length;
+
+	/// <summary>
+	/// Pomija BOM, deklaracje, komentarze i instrukcje przetwarzania przed korzeniem.
+	/// </summary>
+	/// <returns>Pozycja znaku '<' korzenia lub npos</returns>
+	size_t skipProlog(size_t pos)
+	{
+		if (_length >= 3 && startsWith(0, "\xEF\xBB\xBF"))
+			pos = 3;
+		while (pos < _length)
+		{
+			char const * lt = static_cast<char const *>(memchr(_text + pos, '<', _length - pos));
+			if (lt == nullptr || !isWhitespace(pos, lt - _text))
+				return npos;
+			pos = lt - _text;
+			if (startsWith(pos, "<?"))
+				pos = skipPast(pos, "?>");
+			else if (startsWith(pos, "<!--"))
+				pos = skipPast(pos, "-->");
+			else if (startsWith(pos, "<!DOCTYPE"))
+			{
+				size_t end = findTagEnd(pos);
+				// wewnetrzny podzbior DTD moze zawierac znaki '>'
+				if (end == npos || std::find(_text + pos, _text + end, '[') != _text + end)
+					return npos;
+				pos = end + 1;
+			}
+			else
+				return pos;
+		}
+		return npos;
+	}
+
+	/// <summary>
+	/// Znajduje znak '>' konczacy znacznik, pomijajac wartosci atrybutow w cudzyslowach.
+	/// </summary>
+	size_t findTagEnd(size_t pos)
+	{
+		char quote = 0;
+		for (; pos < _length; ++pos)
+		{
+			char c = _text[pos];
+			if (quote)
+			{
+				if (c == quote)
+					quote = 0;
+			}
+			else if (c == '"' || c == '\'')
+				quote = c;
+			else if (c == '>')
+				return pos;
+		}
+		return npos;
+	}
+
+	size_t skipPast(size_t pos, char const * pattern)
+	{
+		size_t patternLength = strlen(pattern);
+		char const * found = std::search(_text + pos, _text + _length, pattern, pattern + patternLength);
+		if (found == _text + _length)
+			return npos;
+		return found - _text + patternLength;
+	}
+
+	bool startsWith(size_t pos, char const * pattern)
+	{
+		size_t patternLength = strlen(pattern);
+		return pos + patternLength <= _length && memcmp(_text + pos, pattern, patternLength) == 0;
+	}
+
+	bool isWhitespace(size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			char c = _text[i];
+			if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+				return false;
+		}
+		return true;
+	}
+};
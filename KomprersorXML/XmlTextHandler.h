@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include "AbstractXmlDecodeHandler.h"
+#include "BufferedXmlWriter.h"
+#include "XmlValueFormatter.h"
+
+/// <summary>
+/// Odbiorca zdarzen dekompresji zapisujacy je jako wciety tekst Xml. Nie dziedziczy po
+/// <see cref="AbstractXmlDecodeHandler"/>, aby wywolania z readXml nie byly wirtualne.
+/// </summary>
+class XmlTextHandler
+{
+	BufferedXmlWriter & _out;
+
+	/// <summary>
+	/// Poziom zagniezdzenia biezacego wezla
+	/// </summary>
+	size_t _depth;
+
+	/// <summary>
+	/// Czy znacznik otwierajacy ostatniego wezla nie zostal jeszcze zamkniety znakiem '>'
+	/// </summary>
+	bool _startTagOpen;
+
+	/// <summary>
+	/// Czy ostatni wezel posiadal wartosc tekstowa
+	/// </summary>
+	bool _hasText;
+
+public:
+	explicit XmlTextHandler(BufferedXmlWriter & out) : _out(out), _depth(0), _startTagOpen(false), _hasText(false) { }
+
+	void startElement(int /*id*/, std::string const & name)
+	{
+		if (_startTagOpen)
+			_out.append(">\n");
+		_out.appendRepeated('\t', _depth);
+		_out.append('<');
+		_out.append(name);
+		++_depth;
+		_startTagOpen = true;
+		_hasText = false;
+	}
+
+	void attribute(int /*id*/, std::string const & name, XmlValue const & value)
+	{
+		_out.append(' ');
+		_out.append(name);
+		_out.append("=\"");
+		appendValue(value);
+		_out.append('"');
+	}
+
+	void text(XmlValue const & value)
+	{
+		_out.append('>');
+		appendValue(value);
+		_startTagOpen = false;
+		_hasText = true;
+	}
+
+	void endElement(int /*id*/, std::string const & name)
+	{
+		--_depth;
+		if (_startTagOpen)
+		{
+			_out.append("/>\n");
+		}
+		else
+		{
+			if (!_hasText)
+				_out.appendRepeated('\t', _depth);
+			_out.append("</");
+			_out.append(name);
+			_out.append(">\n");
+		}
+		_startTagOpen = false;
+		_hasText = false;
+	}
+
+private:
+	void appendValue(XmlValue const & value)
+	{
+		if (value.type == XmlValue::String)
+			_out.append(value.text, value.length);
+		else
+			_out.commit(XmlValueFormatter::format(value, _out.reserve(XmlValueFormatter::MAX_LENGTH)));
+	}
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "AbstractXmlDecodeHandler.h"
+
+/// <summary>
+/// Zamiana wartosci liczbowych na tekst bez alokacji. Liczby calkowite formatowane sa parami cyfr
+/// z tablicy, wartosci 0-255 (flaga CHAR) pobierane sa gotowe z tablicy, a liczby zmiennoprzecinkowe
+/// zapisywane w najkrotszej postaci, z ktorej strtof odtwarza te sama wartosc.
+/// </summary>
+class XmlValueFormatter
+{
+public:
+	/// <summary>
+	/// Maksymalna liczba znakow zapisywanych przez format
+	/// </summary>
+	static const size_t MAX_LENGTH = 32;
+
+	/// <summary>
+	/// Zapisuje wartosc liczbowa jako tekst.
+	/// </summary>
+	/// <param name="value">Wartosc typu innego niz String.</param>
+	/// <param name="out">Bufor o rozmiarze co najmniej MAX_LENGTH.</param>
+	/// <returns>Liczba zapisanych znakow</returns>
+	static size_t format(XmlValue const & value, char * out)
+	{
+		if (value.type == XmlValue::Float)
+			return formatFloat(value.floatValue, out);
+		if (value.type == XmlValue::Char && value.intValue >= 0 && value.intValue <= 255)
+		{
+			ByteTable const & table = byteTable();
+			memcpy(out, table.digits[value.intValue], 3);
+			return table.lengths[value.intValue];
+		}
+		return formatInt(value.intValue, out);
+	}
+
+	static size_t formatInt(int value, char * out)
+	{
+		static const char pairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char digits[10];
+		char * p = digits + sizeof(digits);
+		unsigned int magnitude = value < 0 ? 0u - unsigned(value) : unsigned(value);
+		while (magnitude >= 100)
+		{
+			unsigned int pair = magnitude % 100 * 2;
+			magnitude /= 100;
+			*--p = pairs[pair + 1];
+			*--p = pairs[pair];
+		}
+		if (magnitude >= 10)
+		{
+			*--p = pairs[magnitude * 2 + 1];
+			*--p = pairs[magnitude * 2];
+		}
+		else
+			*--p = char('0' + magnitude);
+		size_t length = digits + sizeof(digits) - p;
+		char * start = out;
+		if (value < 0)
+			*out++ = '-';
+		memcpy(out, p, length);
+		return out + length - start;
+	}
+
+	/// <summary>
+	/// Zapisuje liczbe zmiennoprzecinkowa w najkrotszej postaci odtwarzajacej te sama wartosc.
+	/// Dla liczb znormalizowanych zapis z FLT_DIG cyframi znaczacymi (bez koncowych zer) jest
+	/// najkrotszy, jezeli tylko odtwarza wartosc, wiec zwykle wystarcza jedno formatowanie.
+	/// </summary>
+	static size_t formatFloat(float value, char * out)
+	{
+		int length = 0;
+		int precision = fabsf(value) < FLT_MIN ? 1 : FLT_DIG;
+		for (; precision <= 9; ++precision)
+		{
+			length = snprintf(out, MAX_LENGTH, "%.*g", precision, value);
+			if (strtof(out, 0) == value)
+				break;
+		}
+		// separator dziesietny zalezny od ustawien regionalnych
+		for (int i = 0; i < length; ++i)
+		{
+			if (out[i] == ',')
+				out[i] = '.';
+		}
+		return length;
+	}
+
+private:
+	struct ByteTable
+	{
+		char digits[256][3];
+		unsigned char lengths[256];
+
+		ByteTable()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				char text[4];
+				lengths[i] = (unsigned char)formatInt(i, text);
+				memcpy(digits[i], text, 3);
+			}
+		}
+	};
+
+	static ByteTable const & byteTable()
+	{
+		static const ByteTable table;
+		return table;
+	}
+};
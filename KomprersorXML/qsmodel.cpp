@@ -99,11 +99,21 @@ static void dorescale( qsmodel *m)
 /* init  array of int's to be used for initialisation (NULL ok) */
 /* compress  set to 1 on compression, 0 on decompression */
 void initqsmodel( qsmodel *m, int n, int lg_totf, int rescale, int *init, int compress )
-{   m->n = n;
+{   initqsmodeltbl(m, n, lg_totf, rescale, TBLSHIFT, init, compress);
+}
+
+
+/* initialisation of qsmodel with a given search table */
+/* tblshift  base2 log of the decoder search table size; */
+/*           larger tables need fewer bisection steps in qsgetsym */
+/* other parameters as in initqsmodel                  */
+void initqsmodeltbl( qsmodel *m, int n, int lg_totf, int rescale, int tblshift, int *init, int compress )
+{   if (tblshift > lg_totf)
+        tblshift = lg_totf;
+    m->n = n;
+    m->lgtotf = lg_totf;
     m->targetrescale = rescale;
-    m->searchshift = lg_totf - TBLSHIFT;
-    if (m->searchshift < 0)
-        m->searchshift = 0;
+    m->searchshift = lg_totf - tblshift;
     m->cf = (uint2*)malloc((n+1)*sizeof(uint2));
     m->newf = (uint2*)malloc((n+1)*sizeof(uint2));
     m->cf[n] = 1<<lg_totf;
@@ -111,8 +121,8 @@ void initqsmodel( qsmodel *m, int n, int lg_totf, int rescale, int *init, int co
     if (compress)
         m->search = NULL;
     else
-    {   m->search = (uint2*)malloc(((1<<TBLSHIFT)+1)*sizeof(uint2));
-        m->search[1<<TBLSHIFT] = n-1;
+    {   m->search = (uint2*)malloc(((1<<tblshift)+1)*sizeof(uint2));
+        m->search[1<<tblshift] = n-1;
     }
     resetqsmodel(m, init);
 }
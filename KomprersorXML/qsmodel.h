@@ -47,7 +47,8 @@ typedef struct {
         rescale,       /* intervals between rescales */
         targetrescale, /* should be interval between rescales */
         incr,          /* increment per update */
-        searchshift;   /* shift for lt_freq before using as index */
+        searchshift,   /* shift for lt_freq before using as index */
+        lgtotf;        /* base2 log of total frequency count */
     uint2 *cf,         /* array of cumulative frequencies */
         *newf,         /* array for collecting ststistics */
         *search;       /* structure for searching on decompression */
@@ -63,6 +64,12 @@ typedef struct {
 void initqsmodel( qsmodel *m, int n, int lg_totf, int rescale,
    int *init, int compress );
 
+/* initialisation of qsmodel with a given search table */
+/* tblshift  base2 log of the decoder search table size, at most lg_totf */
+/* other parameters as in initqsmodel                  */
+void initqsmodeltbl( qsmodel *m, int n, int lg_totf, int rescale,
+   int tblshift, int *init, int compress );
+
 /* reinitialisation of qsmodel                         */
 /* m   qsmodel to be initialized                       */
 /* init  array of int's to be used for initialisation (NULL ok) */
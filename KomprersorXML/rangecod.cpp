@@ -42,8 +42,9 @@
   defined in the .c file; change them as needed; the first parameter
   passed to them is a pointer to the rangecoder structure; extend that
   structure as needed (and don't forget to initialize the values in
-  start_encoding resp. start_decoding). This distribution writes to
-  stdout and reads from stdin.
+  start_encoding resp. start_decoding). This version writes to the
+  putbyte/sink callback and reads from the inptr..inend buffer set in
+  the rangecoder structure, so every coder has its own byte stream.
 
   There are no global or static var's, so if the IO is thread save the
   whole rangecoder is - unless GLOBALRANGECODER in rangecod.h is defined.
@@ -79,7 +80,7 @@
 */
 /* #define EXTRAFAST */
 
-#include <stdio.h>		/* fprintf(), getchar(), putchar(), NULL */
+#include <stdio.h>		/* fprintf(), EOF, NULL */
 #include "port.h"
 #include "rangecod.h"
 
@@ -92,8 +93,8 @@
 /* all IO is done by these macros - change them if you want to */
 /* no checking is done - do it here if you want it             */
 /* cod is a pointer to the used rangecoder                     */
-#define outbyte(cod,x) putchar(x)
-#define inbyte(cod)    getchar()
+#define outbyte(cod,x) ((cod)->putbyte((cod)->sink, (unsigned char)(x)))
+#define inbyte(cod)    ((cod)->inptr < (cod)->inend ? *(cod)->inptr++ : EOF)
 
 
 #ifdef RENORM95
@@ -45,8 +45,9 @@
   defined in the .c file; change them as needed; the first parameter
   passed to them is a pointer to the rangecoder structure; extend that
   structure as needed (and don't forget to initialize the values in
-  start_encoding resp. start_decoding). This distribution writes to
-  stdout and reads from stdin.
+  start_encoding resp. start_decoding). This version writes to the
+  putbyte/sink callback and reads from the inptr..inend buffer set in
+  the rangecoder structure, so every coder has its own byte stream.
 
   There are no global or static var's, so if the IO is thread save the
   whole rangecoder is - unless GLOBALRANGECODER in rangecod.h is defined.
@@ -95,6 +96,10 @@ typedef struct {
 /* the following is used only when encoding */
     uint4 bytecount;     /* counter for outputed bytes  */
 /* insert fields you need for input/output below this line! */
+    void (*putbyte)(void *sink, unsigned char c); /* byte sink used when encoding */
+    void *sink;
+    const unsigned char *inptr,  /* next byte to read when decoding */
+          *inend;                /* end of input, EOF is returned past it */
 } rangecoder;
 
 